@@ -0,0 +1,712 @@
+#include "AsyncFile.h"
+#include "Atomic.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define POSIX_THREAD_HAS_IO_URING 1
+#endif
+#endif
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+#ifdef POSIX_THREAD_HAS_IO_URING
+
+// 内核与用户态共享的提交队列 (SQ) 和完成队列 (CQ), 由 mmap 映射
+struct UringState
+{
+  int fd;
+  void *sqRing;
+  size_t sqRingSize;
+  void *cqRing;
+  size_t cqRingSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+
+  unsigned *sqTail; // 只有提交者 (持有 AsyncFile::mutex_) 写
+  unsigned *sqArray;
+  unsigned sqMask;
+  unsigned *cqHead; // 只有收割线程写
+  unsigned *cqTail;
+  unsigned cqMask;
+  struct io_uring_cqe *cqes;
+
+  UringState()
+      : fd(-1),
+        sqRing(MAP_FAILED),
+        sqRingSize(0),
+        cqRing(MAP_FAILED),
+        cqRingSize(0),
+        sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+        sqesSize(0),
+        sqTail(NULL),
+        sqArray(NULL),
+        sqMask(0),
+        cqHead(NULL),
+        cqTail(NULL),
+        cqMask(0),
+        cqes(NULL)
+  {
+  }
+
+  ~UringState()
+  {
+    if (sqes != MAP_FAILED)
+    {
+      ::munmap(sqes, sqesSize);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+    {
+      ::munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED)
+    {
+      ::munmap(sqRing, sqRingSize);
+    }
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+  }
+};
+
+#else
+
+struct UringState
+{
+};
+
+#endif
+
+} // namespace detail
+
+namespace
+{
+
+#ifdef POSIX_THREAD_HAS_IO_URING
+
+// glibc 没有 io_uring 的封装, 直接走系统调用, 不依赖 liburing
+int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void *arg, unsigned nrArgs)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+template <typename T>
+T *ringPointer(void *ring, unsigned offset)
+{
+  return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+
+#endif
+
+// 当前线程正在执行哪个 AsyncFile 的回调, 用来识别 "回调中提交"
+__thread const AsyncFile *t_completingFile = NULL;
+
+// 执行回调期间设置 t_completingFile, 回调可能嵌套提交到别的 AsyncFile, 所以要恢复原值
+class CompletionScope
+{
+public:
+  explicit CompletionScope(const AsyncFile *file)
+      : outer_(t_completingFile)
+  {
+    t_completingFile = file;
+  }
+
+  ~CompletionScope() { t_completingFile = outer_; }
+
+private:
+  const AsyncFile *outer_;
+};
+
+AsyncFile::Callback promiseCallback(const std::shared_ptr<std::promise<ssize_t>> &promise)
+{
+  return [promise](ssize_t result) { promise->set_value(result); };
+}
+
+} // namespace
+
+AsyncFile::AsyncFile(int queueDepth, Backend backend, int fallbackThreads)
+    : backend_(kThreadPool),
+      queueDepth_(queueDepth),
+      submitBatch_(1),
+      mutex_(),
+      notFull_(mutex_),
+      inflight_(0),
+      pending_(0),
+      running_(0),
+      requests_(queueDepth)
+{
+  assert(queueDepth > 0);
+  memset(&stats_, 0, sizeof stats_);
+  for (int i = queueDepth - 1; i >= 0; --i)
+  {
+    freeRequests_.push_back(&requests_[i]);
+  }
+
+  if (backend != kThreadPool && setupUring())
+  {
+    backend_ = kIoUring;
+    reaper_.reset(new Thread(std::bind(&AsyncFile::reap, this), "AsyncFileReaper"));
+    reaper_->start();
+  }
+  else
+  {
+    pool_.reset(new ThreadPool("AsyncFile"));
+    pool_->start(std::max(1, std::min(fallbackThreads, queueDepth)));
+  }
+}
+
+AsyncFile::~AsyncFile()
+{
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    // 回调还在执行时可能继续提交请求, 所以也要等回调返回
+    while (inflight_ > 0 || running_ > 0)
+    {
+      if (pending_ > 0)
+      {
+        enter();
+      }
+      notFull_.Wait();
+    }
+    if (ring_)
+    {
+      // user_data 为 0 的 NOP 通知收割线程退出
+      prepare(NULL);
+      ++pending_;
+      enter();
+    }
+  }
+  if (reaper_)
+  {
+    reaper_->join();
+  }
+  if (pool_)
+  {
+    pool_->stop();
+  }
+}
+
+bool AsyncFile::setupUring()
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  struct io_uring_params params;
+  memset(&params, 0, sizeof params);
+  int fd = ioUringSetup(queueDepth_, &params);
+  if (fd < 0)
+  {
+    return false; // ENOSYS: 内核太老; EPERM: 被 io_uring_disabled 或 seccomp 禁用
+  }
+  std::unique_ptr<detail::UringState> ring(new detail::UringState);
+  ring->fd = fd;
+
+  // IORING_OP_READ/WRITE 是 5.6 才加入的, 用 probe 确认需要的操作都支持
+  const unsigned kProbeOps = 256;
+  std::vector<char> probeBuffer(sizeof(struct io_uring_probe) + kProbeOps * sizeof(struct io_uring_probe_op));
+  struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(probeBuffer.data());
+  if (ioUringRegister(fd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0)
+  {
+    return false;
+  }
+  const int kRequiredOps[] = {IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE,
+                              IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_FSYNC};
+  for (size_t i = 0; i < sizeof kRequiredOps / sizeof kRequiredOps[0]; ++i)
+  {
+    int op = kRequiredOps[i];
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+    {
+      return false;
+    }
+  }
+
+  ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMmap)
+  {
+    ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+  }
+  ring->sqRing = ::mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+  if (ring->sqRing == MAP_FAILED)
+  {
+    return false;
+  }
+  if (singleMmap)
+  {
+    ring->cqRing = ring->sqRing;
+  }
+  else
+  {
+    ring->cqRing = ::mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_CQ_RING);
+    if (ring->cqRing == MAP_FAILED)
+    {
+      return false;
+    }
+  }
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = static_cast<struct io_uring_sqe *>(::mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                                                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+  if (ring->sqes == MAP_FAILED)
+  {
+    return false;
+  }
+
+  ring->sqTail = ringPointer<unsigned>(ring->sqRing, params.sq_off.tail);
+  ring->sqArray = ringPointer<unsigned>(ring->sqRing, params.sq_off.array);
+  ring->sqMask = *ringPointer<unsigned>(ring->sqRing, params.sq_off.ring_mask);
+  ring->cqHead = ringPointer<unsigned>(ring->cqRing, params.cq_off.head);
+  ring->cqTail = ringPointer<unsigned>(ring->cqRing, params.cq_off.tail);
+  ring->cqMask = *ringPointer<unsigned>(ring->cqRing, params.cq_off.ring_mask);
+  ring->cqes = ringPointer<struct io_uring_cqe>(ring->cqRing, params.cq_off.cqes);
+
+  // SQ array 固定为恒等映射, 第 i 个 sqe 就放在 sqes[i]
+  for (unsigned i = 0; i < params.sq_entries; ++i)
+  {
+    ring->sqArray[i] = i;
+  }
+  ring_.swap(ring);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool AsyncFile::registerFiles(const std::vector<int> &fds)
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (!ring_ || fds.empty() || !fixedFiles_.empty())
+  {
+    return false;
+  }
+  assert(inflight_ == 0);
+  if (ioUringRegister(ring_->fd, IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(fds.size())) < 0)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    assert(fds[i] >= 0);
+    if (static_cast<size_t>(fds[i]) >= fixedFiles_.size())
+    {
+      fixedFiles_.resize(fds[i] + 1, -1);
+    }
+    fixedFiles_[fds[i]] = static_cast<int>(i);
+  }
+  return true;
+#else
+  (void)fds;
+  return false;
+#endif
+}
+
+bool AsyncFile::registerBuffers(const std::vector<struct iovec> &buffers)
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (!ring_ || buffers.empty() || !fixedBuffers_.empty())
+  {
+    return false;
+  }
+  assert(inflight_ == 0);
+  // 注册时内核 pin 住这些页, 受 RLIMIT_MEMLOCK 限制
+  if (ioUringRegister(ring_->fd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) < 0)
+  {
+    return false;
+  }
+  fixedBuffers_ = buffers;
+  return true;
+#else
+  (void)buffers;
+  return false;
+#endif
+}
+
+void AsyncFile::setSubmitBatch(int batch)
+{
+  assert(batch > 0);
+  MutexLockGuard<MutexLock> lock(mutex_);
+  submitBatch_ = batch;
+}
+
+void AsyncFile::read(int fd, void *buf, size_t len, off_t offset, Callback cb)
+{
+  submit(kRead, fd, buf, len, offset, false, std::move(cb));
+}
+
+void AsyncFile::write(int fd, const void *buf, size_t len, off_t offset, Callback cb)
+{
+  submit(kWrite, fd, const_cast<void *>(buf), len, offset, false, std::move(cb));
+}
+
+void AsyncFile::fsync(int fd, bool dataOnly, Callback cb)
+{
+  submit(kFsync, fd, NULL, 0, 0, dataOnly, std::move(cb));
+}
+
+std::future<ssize_t> AsyncFile::read(int fd, void *buf, size_t len, off_t offset)
+{
+  std::shared_ptr<std::promise<ssize_t>> promise(new std::promise<ssize_t>);
+  std::future<ssize_t> future = promise->get_future();
+  read(fd, buf, len, offset, promiseCallback(promise));
+  return future;
+}
+
+std::future<ssize_t> AsyncFile::write(int fd, const void *buf, size_t len, off_t offset)
+{
+  std::shared_ptr<std::promise<ssize_t>> promise(new std::promise<ssize_t>);
+  std::future<ssize_t> future = promise->get_future();
+  write(fd, buf, len, offset, promiseCallback(promise));
+  return future;
+}
+
+std::future<ssize_t> AsyncFile::fsync(int fd, bool dataOnly)
+{
+  std::shared_ptr<std::promise<ssize_t>> promise(new std::promise<ssize_t>);
+  std::future<ssize_t> future = promise->get_future();
+  fsync(fd, dataOnly, promiseCallback(promise));
+  return future;
+}
+
+void AsyncFile::flush()
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (pending_ > 0)
+  {
+    enter();
+  }
+}
+
+AsyncFileStats AsyncFile::stats() const
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  return stats_;
+}
+
+void AsyncFile::submit(Op op, int fd, void *buf, size_t len, off_t offset, bool dataOnly, Callback cb)
+{
+  Request *req = NULL;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    if (inflight_ >= queueDepth_ && t_completingFile == this)
+    {
+      Request overflow;
+      overflow.op = op;
+      overflow.fd = fd;
+      overflow.buf = buf;
+      overflow.len = len;
+      overflow.offset = offset;
+      overflow.dataOnly = dataOnly;
+      overflow.cb.swap(cb);
+      overflow_.push_back(std::move(overflow));
+      ++stats_.submitted;
+      return;
+    }
+    while (inflight_ >= queueDepth_)
+    {
+      // 攒着的请求不交给内核就永远不会完成
+      if (pending_ > 0)
+      {
+        enter();
+      }
+      notFull_.Wait();
+    }
+    req = freeRequests_.back();
+    freeRequests_.pop_back();
+    ++inflight_;
+    ++stats_.submitted;
+
+    req->op = op;
+    req->fd = fd;
+    req->buf = buf;
+    req->len = len;
+    req->offset = offset;
+    req->dataOnly = dataOnly;
+    req->cb.swap(cb);
+
+    if (ring_)
+    {
+      prepare(req);
+      ++pending_;
+      if (pending_ >= submitBatch_)
+      {
+        enter();
+      }
+      return;
+    }
+  }
+  dispatch(req);
+}
+
+// 必须持有 mutex_, req 为 NULL 时放入退出用的 NOP
+void AsyncFile::prepare(Request *req)
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  detail::UringState *ring = ring_.get();
+  // 在飞的请求数不超过 queueDepth <= sq_entries, 所以 SQ 不会满
+  unsigned tail = *ring->sqTail;
+  unsigned index = tail & ring->sqMask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof *sqe);
+
+  if (req == NULL)
+  {
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+  }
+  else
+  {
+    int slot = static_cast<size_t>(req->fd) < fixedFiles_.size() ? fixedFiles_[req->fd] : -1;
+    if (slot >= 0)
+    {
+      sqe->fd = slot;
+      sqe->flags = IOSQE_FIXED_FILE;
+    }
+    else
+    {
+      sqe->fd = req->fd;
+    }
+    sqe->user_data = reinterpret_cast<uintptr_t>(req);
+
+    if (req->op == kFsync)
+    {
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->fsync_flags = req->dataOnly ? IORING_FSYNC_DATASYNC : 0;
+    }
+    else
+    {
+      assert(req->len <= UINT32_MAX);
+      sqe->addr = reinterpret_cast<uintptr_t>(req->buf);
+      sqe->len = static_cast<uint32_t>(req->len);
+      sqe->off = static_cast<uint64_t>(req->offset);
+      sqe->opcode = req->op == kRead ? IORING_OP_READ : IORING_OP_WRITE;
+
+      const char *begin = static_cast<const char *>(req->buf);
+      for (size_t i = 0; i < fixedBuffers_.size(); ++i)
+      {
+        const char *base = static_cast<const char *>(fixedBuffers_[i].iov_base);
+        if (begin >= base && begin + req->len <= base + fixedBuffers_[i].iov_len)
+        {
+          sqe->opcode = req->op == kRead ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+          sqe->buf_index = static_cast<uint16_t>(i);
+          break;
+        }
+      }
+    }
+  }
+  ring->sqArray[index] = index;
+  detail::atomicStore(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+#else
+  (void)req;
+#endif
+}
+
+// 必须持有 mutex_, 把 pending_ 个 sqe 交给内核
+void AsyncFile::enter()
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  while (pending_ > 0)
+  {
+    int ret = ioUringEnter(ring_->fd, pending_, 0, 0);
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EBUSY)
+      {
+        break; // 内核暂时没有资源, 留到下一次提交或者有请求完成时再试
+      }
+      fprintf(stderr, "File:%s, Line:%d, io_uring_enter: %s\n", __FILE__, __LINE__, strerror(errno));
+      abort();
+    }
+    ++stats_.enterCalls;
+    pending_ -= ret;
+    if (ret == 0)
+    {
+      break;
+    }
+  }
+#endif
+}
+
+// 收割线程: 等待完成事件, 一轮取出所有 cqe, 归还 Request 后再执行回调
+void AsyncFile::reap()
+{
+#ifdef POSIX_THREAD_HAS_IO_URING
+  detail::UringState *ring = ring_.get();
+  std::vector<Request *> done;
+  std::vector<ssize_t> results;
+  std::vector<Callback> callbacks;
+  bool quit = false;
+
+  while (!quit)
+  {
+    if (ioUringEnter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+    {
+      fprintf(stderr, "File:%s, Line:%d, io_uring_enter: %s\n", __FILE__, __LINE__, strerror(errno));
+      abort();
+    }
+
+    unsigned head = *ring->cqHead;
+    unsigned tail = detail::atomicLoad(ring->cqTail, __ATOMIC_ACQUIRE);
+    done.clear();
+    results.clear();
+    for (; head != tail; ++head)
+    {
+      const struct io_uring_cqe &cqe = ring->cqes[head & ring->cqMask];
+      if (cqe.user_data == 0)
+      {
+        quit = true;
+        continue;
+      }
+      done.push_back(reinterpret_cast<Request *>(static_cast<uintptr_t>(cqe.user_data)));
+      results.push_back(cqe.res);
+    }
+    detail::atomicStore(ring->cqHead, head, __ATOMIC_RELEASE);
+    if (done.empty())
+    {
+      continue;
+    }
+
+    callbacks.resize(done.size());
+    for (size_t i = 0; i < done.size(); ++i)
+    {
+      callbacks[i].swap(done[i]->cb);
+    }
+    release(done.data(), done.size());
+    {
+      CompletionScope scope(this);
+      for (size_t i = 0; i < callbacks.size(); ++i)
+      {
+        callbacks[i](results[i]);
+        callbacks[i] = Callback();
+      }
+    }
+    finishCallbacks(done.size());
+  }
+#endif
+}
+
+void AsyncFile::runFallback(Request *req)
+{
+  ssize_t result;
+  switch (req->op)
+  {
+  case kRead:
+    result = ::pread(req->fd, req->buf, req->len, req->offset);
+    break;
+  case kWrite:
+    result = ::pwrite(req->fd, req->buf, req->len, req->offset);
+    break;
+  default:
+    result = req->dataOnly ? ::fdatasync(req->fd) : ::fsync(req->fd);
+    break;
+  }
+  if (result < 0)
+  {
+    result = -errno;
+  }
+
+  Callback cb;
+  cb.swap(req->cb);
+  release(&req, 1);
+  {
+    CompletionScope scope(this);
+    cb(result);
+  }
+  finishCallbacks(1);
+}
+
+// 线程池后端: 把请求交给线程池, 线程池不接受 (已经停止) 时在当前线程执行
+void AsyncFile::dispatch(Request *req)
+{
+  if (!pool_->run(std::bind(&AsyncFile::runFallback, this, req)))
+  {
+    runFallback(req);
+  }
+}
+
+// 归还 Request, 空出来的位置先补给溢出队列中的请求. 调用者执行完这些请求的回调之后调用 finishCallbacks()
+void AsyncFile::release(Request **reqs, size_t count)
+{
+  std::vector<Request *> fallback;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    for (size_t i = 0; i < count; ++i)
+    {
+      freeRequests_.push_back(reqs[i]);
+    }
+    inflight_ -= static_cast<int>(count);
+    running_ += static_cast<int>(count);
+    stats_.completed += count;
+
+    while (!overflow_.empty() && !freeRequests_.empty())
+    {
+      Request *req = freeRequests_.back();
+      freeRequests_.pop_back();
+      ++inflight_;
+      *req = std::move(overflow_.front());
+      overflow_.pop_front();
+      if (ring_)
+      {
+        // 收割线程执行完这一轮回调后 flush() 统一提交
+        prepare(req);
+        ++pending_;
+      }
+      else
+      {
+        fallback.push_back(req);
+      }
+    }
+    notFull_.SignalAll();
+  }
+  // 线程池后端在锁外把补上的请求交给线程池
+  for (size_t i = 0; i < fallback.size(); ++i)
+  {
+    dispatch(fallback[i]);
+  }
+}
+
+// 一轮回调执行完: 提交回调中攒下的请求, 再让析构函数知道这些回调已经返回
+void AsyncFile::finishCallbacks(size_t count)
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (pending_ > 0)
+  {
+    enter();
+  }
+  running_ -= static_cast<int>(count);
+  if (running_ == 0)
+  {
+    notFull_.SignalAll();
+  }
+}
+
+__POSIX_THREAD_END
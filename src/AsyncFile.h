@@ -0,0 +1,144 @@
+#ifndef __ASYNC_FILE_H__
+#define __ASYNC_FILE_H__
+
+#include "posix_thread.h"
+#include <deque>
+#include <future>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+__POSIX_THREAD_BEGIN
+
+class ThreadPool;
+
+namespace detail
+{
+struct UringState;
+} // namespace detail
+
+struct AsyncFileStats
+{
+  uint64_t submitted;  // 已提交的请求数
+  uint64_t completed;  // 已完成 (回调已取出) 的请求数
+  uint64_t enterCalls; // 提交请求的 io_uring_enter 调用次数, submitted / enterCalls 即平均批量
+};
+
+/**
+ * AsyncFile: 异步文件 I/O
+ *
+ *  线程池中的线程直接调用 read/write 时, 每个慢 I/O 都会占住一个线程睡在内核里,
+ *  吞吐量受限于能停放多少个线程。AsyncFile 通过 io_uring 提交 read/write/fsync,
+ *  提交者不阻塞, 由一个专门的收割线程 (reaper) 等待完成事件并执行回调或完成 future。
+ *
+ *  - 提交队列按 setSubmitBatch() 攒批, 攒够 batch 个或调用 flush() 时用一次 io_uring_enter 提交;
+ *    回调中提交的请求在这一轮回调全部执行完之后统一提交。
+ *  - registerFiles()/registerBuffers() 把 fd 和缓冲区注册给内核 (fixed files/registered buffers),
+ *    之后对这些 fd 和落在注册缓冲区内的读写不再需要每次查 fd 表和 pin 内存页。
+ *  - 同时在飞的请求数不超过 queueDepth, 超过时提交者阻塞 (先把攒着的请求提交掉)。
+ *    回调中提交时不阻塞: 只有完成事件能腾出位置, 而执行回调的线程 (收割线程或线程池线程) 阻塞了就没人处理完成事件,
+ *    所以这时请求放进没有上限的溢出队列, 有请求完成时按顺序补进空出来的位置。
+ *  - 内核不支持 io_uring (或者被禁用) 时自动退化为 ThreadPool + pread/pwrite,
+ *    此时回调在线程池的线程中执行, 注册函数返回 false 但不影响读写。
+ *
+ *  回调参数: >= 0 为读写的字节数 (不会自动重试短读写), < 0 为 -errno。
+ *  回调在收割线程中执行, 不要在回调中做耗时的事情。析构时等待所有请求完成, 包括回调返回
+ *  (回调中提交的请求也算在内)。
+ */
+class AsyncFile
+{
+public:
+  using Callback = std::function<void(ssize_t result)>;
+
+  enum Backend
+  {
+    kAuto,
+    kIoUring,
+    kThreadPool,
+  };
+
+  AsyncFile(const AsyncFile &file) = delete;
+  AsyncFile &operator=(const AsyncFile &file) = delete;
+
+  // backend 为 kIoUring 但内核不支持时同样退化为 kThreadPool, 用 backend() 查询实际使用的后端
+  explicit AsyncFile(int queueDepth = 64, Backend backend = kAuto, int fallbackThreads = 4);
+  ~AsyncFile();
+
+  Backend backend() const { return backend_; }
+  int queueDepth() const { return queueDepth_; }
+
+  // 必须在提交第一个请求之前调用, 返回注册是否生效
+  bool registerFiles(const std::vector<int> &fds);
+  bool registerBuffers(const std::vector<struct iovec> &buffers);
+  // 默认为 1, 即每个请求立即提交
+  void setSubmitBatch(int batch);
+
+  void read(int fd, void *buf, size_t len, off_t offset, Callback cb);
+  void write(int fd, const void *buf, size_t len, off_t offset, Callback cb);
+  // dataOnly 为 true 时相当于 fdatasync
+  void fsync(int fd, bool dataOnly, Callback cb);
+
+  // batch > 1 时, 等待 future 之前需要 flush()
+  std::future<ssize_t> read(int fd, void *buf, size_t len, off_t offset);
+  std::future<ssize_t> write(int fd, const void *buf, size_t len, off_t offset);
+  std::future<ssize_t> fsync(int fd, bool dataOnly = false);
+
+  // 提交所有攒着的请求
+  void flush();
+
+  AsyncFileStats stats() const;
+
+private:
+  enum Op
+  {
+    kRead,
+    kWrite,
+    kFsync,
+  };
+
+  struct Request
+  {
+    Op op;
+    int fd;
+    void *buf;
+    size_t len;
+    off_t offset;
+    bool dataOnly;
+    Callback cb;
+  };
+
+  bool setupUring();
+  void submit(Op op, int fd, void *buf, size_t len, off_t offset, bool dataOnly, Callback cb);
+  void prepare(Request *req);
+  void enter();
+  void reap();
+  void runFallback(Request *req);
+  void dispatch(Request *req);
+  void release(Request **reqs, size_t count);
+  void finishCallbacks(size_t count);
+
+private:
+  Backend backend_;
+  int queueDepth_;
+  int submitBatch_;
+
+  mutable MutexLock mutex_;
+  Condition notFull_;
+  int inflight_; // 已经占用 Request 的请求数 (包括攒着还没提交的)
+  int pending_;  // 已经放进提交队列还没交给内核的请求数
+  int running_;  // 已经归还 Request 但回调还没有返回的请求数
+  std::vector<Request> requests_;
+  std::vector<Request *> freeRequests_;
+  std::deque<Request> overflow_; // 回调中提交而队列已满的请求, 非空时 freeRequests_ 一定为空
+  AsyncFileStats stats_;
+
+  std::unique_ptr<detail::UringState> ring_;
+  std::vector<int> fixedFiles_; // 下标为 fd, 值为注册的槽位, -1 表示没有注册
+  std::vector<struct iovec> fixedBuffers_;
+  std::unique_ptr<Thread> reaper_;
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+__POSIX_THREAD_END
+#endif // !__ASYNC_FILE_H__
@@ -89,6 +89,49 @@ private:
   volatile T value_;
 };
 
+// gcc >= 4.7 的 __atomic 内建函数, 可以显式指定内存序(__ATOMIC_RELAXED/ACQUIRE/RELEASE/SEQ_CST)
+// 库内部的 lock-free 结构直接作用在普通字段上, 例如单写者计数器只需要 relaxed 读写,
+// 不必像 __sync_* 那样每次都带上完整的内存屏障.
+template <typename T>
+inline T atomicLoad(const volatile T *ptr, int order = __ATOMIC_SEQ_CST)
+{
+  return __atomic_load_n(ptr, order);
+}
+
+template <typename T>
+inline void atomicStore(volatile T *ptr, T value, int order = __ATOMIC_SEQ_CST)
+{
+  __atomic_store_n(ptr, value, order);
+}
+
+template <typename T>
+inline T atomicFetchAdd(volatile T *ptr, T value, int order = __ATOMIC_SEQ_CST)
+{
+  return __atomic_fetch_add(ptr, value, order);
+}
+
+template <typename T>
+inline T atomicExchange(volatile T *ptr, T value, int order = __ATOMIC_SEQ_CST)
+{
+  return __atomic_exchange_n(ptr, value, order);
+}
+
+// 失败时把当前值写回 expected, 与 std::atomic::compare_exchange_strong 语义一致
+template <typename T>
+inline bool atomicCompareExchange(volatile T *ptr, T &expected, T desired,
+                                  int success = __ATOMIC_SEQ_CST,
+                                  int failure = __ATOMIC_SEQ_CST)
+{
+  return __atomic_compare_exchange_n(ptr, &expected, desired, false, success, failure);
+}
+
+// 只有一个线程写的计数器: 读-改-写不需要 lock 前缀, 读者用 relaxed load 拿到的值不会撕裂
+template <typename T>
+inline void relaxedAdd(volatile T *ptr, T value)
+{
+  __atomic_store_n(ptr, __atomic_load_n(ptr, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
 } // namespace detail
 
 using AtomicInt32 = detail::AtomicIntegerT<int32_t>;
@@ -96,4 +139,4 @@ using AtomicInt64 = detail::AtomicIntegerT<int64_t>;
 
 __POSIX_THREAD_END
 
-#endif // __ATOMIC_H__
\ No newline at end of file
+#endif // __ATOMIC_H__
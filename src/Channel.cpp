@@ -0,0 +1,108 @@
+#include "Channel.h"
+#include "EventLoop.h"
+#include <assert.h>
+#include <sys/epoll.h>
+
+__POSIX_THREAD_BEGIN
+
+const int Channel::kNoneEvent = 0;
+const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
+const int Channel::kWriteEvent = EPOLLOUT;
+
+Channel::Channel(EventLoop *loop, int fd)
+    : loop_(loop),
+      fd_(fd),
+      events_(0),
+      revents_(0),
+      addedToLoop_(false),
+      eventHandling_(false)
+{
+}
+
+Channel::~Channel()
+{
+  assert(!eventHandling_);
+  assert(!addedToLoop_);
+  if (loop_->isInLoopThread())
+  {
+    assert(!loop_->hasChannel(this));
+  }
+}
+
+void Channel::enableReading()
+{
+  events_ |= kReadEvent;
+  update();
+}
+
+void Channel::disableReading()
+{
+  events_ &= ~kReadEvent;
+  update();
+}
+
+void Channel::enableWriting()
+{
+  events_ |= kWriteEvent;
+  update();
+}
+
+void Channel::disableWriting()
+{
+  events_ &= ~kWriteEvent;
+  update();
+}
+
+void Channel::disableAll()
+{
+  events_ = kNoneEvent;
+  update();
+}
+
+void Channel::update()
+{
+  loop_->updateChannel(this);
+}
+
+void Channel::remove()
+{
+  assert(isNoneEvent());
+  loop_->removeChannel(this);
+}
+
+void Channel::handleEvent()
+{
+  eventHandling_ = true;
+  // 对端关闭且没有可读数据
+  if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
+  {
+    if (closeCallback_)
+    {
+      closeCallback_();
+    }
+  }
+  if (revents_ & EPOLLERR)
+  {
+    if (errorCallback_)
+    {
+      errorCallback_();
+    }
+  }
+  if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP))
+  {
+    if (readCallback_)
+    {
+      readCallback_();
+    }
+  }
+  if (revents_ & EPOLLOUT)
+  {
+    if (writeCallback_)
+    {
+      writeCallback_();
+    }
+  }
+  eventHandling_ = false;
+}
+
+__POSIX_THREAD_END
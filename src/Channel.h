@@ -0,0 +1,82 @@
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include "posix_define.h"
+#include <functional>
+
+__POSIX_THREAD_BEGIN
+
+class EventLoop;
+
+/**
+ * Channel (参考 muduo net::Channel)
+ *
+ *  一个 Channel 对应一个文件描述符, 负责把 fd 上的 IO 事件分发给不同的回调, 但不拥有 fd,
+ *  析构时也不关闭 fd。Channel 只属于一个 EventLoop, 所有成员函数都只能在该 loop 所在的线程调用。
+ *
+ *  注册到 epoll 时总是带 EPOLLET (边沿触发): 事件只在状态变化时通知一次,
+ *  读回调必须一直读到 EAGAIN, 写回调必须一直写到 EAGAIN 或者数据写完, 否则不会再收到通知。
+ *  所以 fd 应当设置为非阻塞。
+ */
+class Channel
+{
+public:
+  using EventCallback = std::function<void()>;
+
+  Channel(const Channel &channel) = delete;
+  Channel &operator=(const Channel &channel) = delete;
+
+  Channel(EventLoop *loop, int fd);
+  ~Channel();
+
+  void handleEvent();
+
+  void setReadCallback(const EventCallback &cb) { readCallback_ = cb; }
+  void setWriteCallback(const EventCallback &cb) { writeCallback_ = cb; }
+  void setCloseCallback(const EventCallback &cb) { closeCallback_ = cb; }
+  void setErrorCallback(const EventCallback &cb) { errorCallback_ = cb; }
+
+  int fd() const { return fd_; }
+  int events() const { return events_; }
+  void setRevents(int revents) { revents_ = revents; } // used by EventLoop
+  bool isNoneEvent() const { return events_ == kNoneEvent; }
+
+  void enableReading();
+  void disableReading();
+  void enableWriting();
+  void disableWriting();
+  void disableAll();
+  bool isWriting() const { return events_ & kWriteEvent; }
+  bool isReading() const { return events_ & kReadEvent; }
+
+  // used by EventLoop, 是否已经注册到 epoll
+  bool addedToLoop() const { return addedToLoop_; }
+  void setAddedToLoop(bool added) { addedToLoop_ = added; }
+
+  EventLoop *ownerLoop() { return loop_; }
+  // 从 EventLoop 中移除, 析构之前必须调用 (先 disableAll())
+  void remove();
+
+private:
+  void update();
+
+private:
+  static const int kNoneEvent;
+  static const int kReadEvent;
+  static const int kWriteEvent;
+
+  EventLoop *loop_;
+  const int fd_;
+  int events_;  // 关心的事件
+  int revents_; // epoll 返回的活动事件
+  bool addedToLoop_;
+  bool eventHandling_;
+
+  EventCallback readCallback_;
+  EventCallback writeCallback_;
+  EventCallback closeCallback_;
+  EventCallback errorCallback_;
+};
+
+__POSIX_THREAD_END
+#endif // !__CHANNEL_H__
@@ -0,0 +1,514 @@
+#ifndef __CONCURRENT_HASH_MAP_H__
+#define __CONCURRENT_HASH_MAP_H__
+
+#include "LockPolicy.h"
+#include "Atomic.h"
+#include "SpinWait.h"
+#include <assert.h>
+#include <functional>
+#include <new>
+#include <stdlib.h>
+#include <type_traits>
+#include <vector>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * 分片的并发哈希表, 用来替代 "一把 MutexLock + std::unordered_map" 的共享缓存。
+ *
+ *  1. 按哈希值的高位分成 2 的幂个分片, 每个分片独占缓存行, 有自己的锁, 不同分片之间互不阻塞。
+ *  2. 分片内是开放寻址 (线性探测) 的数组, 删除留下墓碑。
+ *  3. 读操作是乐观的: 分片带一个 seqlock 版本号, 写者修改期间版本号为奇数, 读者不加锁探测,
+ *     前后版本号一致才采信结果, 重试几次仍失败再退回加锁读。
+ *     只有 K 和 V 都是 trivially copyable 时才走乐观路径 (并发读到撕裂的 std::string 是不安全的),
+ *     否则读操作也加锁。
+ *  4. 扩容是渐进的 (类似 Redis rehash): 分配两倍大小的新表后, 之后每次写操作顺带搬迁一小批旧表中的槽位,
+ *     查找时新旧两张表都查. 不会一次性搬迁整个分片, 更不会停下整个哈希表。
+ *     乐观读者可能还在读旧表, 所以搬迁完的旧表不立即释放, 留到析构时释放。
+ *     只有容量翻倍时才会换表, 退役的表依次是当前表的 1/2, 1/4, ..., 总量不超过当前表的大小。
+ *  5. 墓碑占满时如果存活的元素不到容量的一半, 不换表, 在写区间内原地重建 (compact),
+ *     插入/删除反复交替的负载下内存不会增长。重建期间乐观读者看到奇数版本号, 会退回加锁读。
+ *
+ *  K, V 需要可默认构造; computeIfAbsent/upsert 的回调在分片锁内执行, 应当尽量短。
+ *  Mutex 是分片锁的策略 (见 LockPolicy.h): 临界区很短, 可以换成 SpinLock/FastMutex;
+ *  单线程使用时用 NullMutex, 此时读操作也不走 seqlock, 只剩哈希表本身的开销。
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+          typename Mutex = MutexLock>
+class ConcurrentHashMap
+{
+public:
+  ConcurrentHashMap(const ConcurrentHashMap &map) = delete;
+  ConcurrentHashMap &operator=(const ConcurrentHashMap &map) = delete;
+
+  // shardCount 会向上取整为 2 的幂, initialCapacity 是每个分片的初始槽位数
+  explicit ConcurrentHashMap(size_t shardCount = 16, size_t initialCapacity = 16)
+      : shardCount_(roundUpPowerOfTwo(shardCount)),
+        shards_(NULL)
+  {
+    void *memory = NULL;
+    if (::posix_memalign(&memory, POSIX_CACHELINE_SIZE, sizeof(Shard) * shardCount_) != 0)
+    {
+      throw std::bad_alloc();
+    }
+    shards_ = static_cast<Shard *>(memory);
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+      new (&shards_[i]) Shard(roundUpPowerOfTwo(initialCapacity < 4 ? 4 : initialCapacity));
+    }
+  }
+
+  ~ConcurrentHashMap()
+  {
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+      shards_[i].~Shard();
+    }
+    ::free(shards_);
+  }
+
+  bool find(const K &key, V *value) const
+  {
+    size_t hash = hashOf(key);
+    Shard &shard = shardFor(hash);
+    if (kOptimisticReads)
+    {
+      for (int attempt = 0; attempt < kOptimisticRetries; ++attempt)
+      {
+        uint64_t version = detail::atomicLoad(&shard.version, __ATOMIC_ACQUIRE);
+        if (version & 1)
+        {
+          detail::cpuRelax();
+          continue;
+        }
+        V result = V();
+        bool found = shard.lookup(hash, key, &result, equal_);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (detail::atomicLoad(&shard.version, __ATOMIC_RELAXED) == version)
+        {
+          if (found && value)
+          {
+            *value = result;
+          }
+          return found;
+        }
+      }
+    }
+
+    MutexLockGuard<Mutex> lock(shard.mutex);
+    return shard.lookup(hash, key, value, equal_);
+  }
+
+  bool contains(const K &key) const
+  {
+    return find(key, NULL);
+  }
+
+  // 存在时返回已有的值, 否则插入 compute() 的返回值
+  template <typename Compute>
+  V computeIfAbsent(const K &key, Compute compute)
+  {
+    V value;
+    if (find(key, &value))
+    {
+      return value;
+    }
+
+    size_t hash = hashOf(key);
+    Shard &shard = shardFor(hash);
+    MutexLockGuard<Mutex> lock(shard.mutex);
+    Slot *slot = shard.locate(hash, key, equal_);
+    if (slot)
+    {
+      return slot->value;
+    }
+    value = compute();
+    WriteScope scope(shard);
+    shard.insertNew(hash, key, value);
+    return value;
+  }
+
+  // 插入或覆盖
+  void upsert(const K &key, const V &value)
+  {
+    upsert(key, value, [&value](V &current) { current = value; });
+  }
+
+  // 不存在时插入 initial, 存在时对已有的值调用 update(V &)
+  template <typename Update>
+  void upsert(const K &key, const V &initial, Update update)
+  {
+    size_t hash = hashOf(key);
+    Shard &shard = shardFor(hash);
+    MutexLockGuard<Mutex> lock(shard.mutex);
+    WriteScope scope(shard);
+    Slot *slot = shard.locate(hash, key, equal_);
+    if (slot)
+    {
+      update(slot->value);
+    }
+    else
+    {
+      shard.insertNew(hash, key, initial);
+    }
+  }
+
+  // 已存在时不覆盖, 返回 false
+  bool insert(const K &key, const V &value)
+  {
+    size_t hash = hashOf(key);
+    Shard &shard = shardFor(hash);
+    MutexLockGuard<Mutex> lock(shard.mutex);
+    if (shard.locate(hash, key, equal_))
+    {
+      return false;
+    }
+    WriteScope scope(shard);
+    shard.insertNew(hash, key, value);
+    return true;
+  }
+
+  bool erase(const K &key)
+  {
+    size_t hash = hashOf(key);
+    Shard &shard = shardFor(hash);
+    MutexLockGuard<Mutex> lock(shard.mutex);
+    Slot *slot = shard.locate(hash, key, equal_);
+    if (slot == NULL)
+    {
+      return false;
+    }
+    WriteScope scope(shard);
+    slot->state = kDeleted;
+    slot->key = K();
+    slot->value = V();
+    detail::relaxedAdd(&shard.size, static_cast<size_t>(-1));
+    shard.migrate(kMigrateBatch);
+    return true;
+  }
+
+  // 各分片大小之和, 并发修改时只是近似值
+  size_t size() const
+  {
+    size_t total = 0;
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+      total += detail::atomicLoad(&shards_[i].size, __ATOMIC_RELAXED);
+    }
+    return total;
+  }
+
+  size_t shardCount() const { return shardCount_; }
+
+private:
+  enum SlotState
+  {
+    kEmpty = 0,
+    kFull = 1,
+    kDeleted = 2,
+  };
+
+  struct Slot
+  {
+    uint8_t state;
+    size_t hash;
+    K key;
+    V value;
+
+    Slot() : state(kEmpty), hash(0), key(), value() {}
+  };
+
+  struct Table
+  {
+    size_t mask;
+    size_t used; // kFull + kDeleted 的槽位数
+    Slot *slots;
+
+    explicit Table(size_t capacity)
+        : mask(capacity - 1),
+          used(0),
+          slots(new Slot[capacity])
+    {
+    }
+
+    ~Table() { delete[] slots; }
+
+    size_t capacity() const { return mask + 1; }
+
+    // 乐观读时表的内容可能正在被修改, 探测次数以容量为上限, 结果由调用者用版本号校验
+    template <typename Equal>
+    Slot *probe(size_t hash, const K &key, const Equal &equal)
+    {
+      size_t index = hash & mask;
+      for (size_t i = 0; i <= mask; ++i)
+      {
+        Slot &slot = slots[(index + i) & mask];
+        if (slot.state == kEmpty)
+        {
+          return NULL;
+        }
+        if (slot.state == kFull && slot.hash == hash && equal(slot.key, key))
+        {
+          return &slot;
+        }
+      }
+      return NULL;
+    }
+
+    Slot *emptySlot(size_t hash)
+    {
+      size_t index = hash & mask;
+      for (;;)
+      {
+        Slot &slot = slots[index];
+        if (slot.state != kFull)
+        {
+          return &slot;
+        }
+        index = (index + 1) & mask;
+      }
+    }
+  };
+
+  // 按缓存行对齐, 每个分片的锁和版本号独占缓存行
+  struct alignas(POSIX_CACHELINE_SIZE) Shard
+  {
+    Mutex mutex;
+    uint64_t version; // seqlock: 奇数表示写者正在修改
+    Table *table;     // 新数据写入的表
+    Table *old;       // 正在搬迁的旧表, 没有搬迁时为 NULL
+    size_t migrateIndex;
+    size_t size;
+    std::vector<Table *> retired;
+
+    explicit Shard(size_t capacity)
+        : version(0),
+          table(new Table(capacity)),
+          old(NULL),
+          migrateIndex(0),
+          size(0)
+    {
+    }
+
+    ~Shard()
+    {
+      delete table;
+      delete old;
+      for (size_t i = 0; i < retired.size(); ++i)
+      {
+        delete retired[i];
+      }
+    }
+
+    template <typename Equal>
+    bool lookup(size_t hash, const K &key, V *value, const Equal &equal)
+    {
+      Table *current = detail::atomicLoad(&table, __ATOMIC_ACQUIRE);
+      Table *previous = detail::atomicLoad(&old, __ATOMIC_ACQUIRE);
+      Slot *slot = current->probe(hash, key, equal);
+      if (slot == NULL && previous != NULL)
+      {
+        slot = previous->probe(hash, key, equal);
+      }
+      if (slot && value)
+      {
+        *value = slot->value;
+      }
+      return slot != NULL;
+    }
+
+    // 持锁查找, 旧表中找到的槽位先搬到新表, 返回值总在新表中
+    template <typename Equal>
+    Slot *locate(size_t hash, const K &key, const Equal &equal)
+    {
+      Slot *slot = table->probe(hash, key, equal);
+      if (slot == NULL && old != NULL)
+      {
+        Slot *stale = old->probe(hash, key, equal);
+        if (stale)
+        {
+          WriteScope scope(*this);
+          slot = moveToTable(stale);
+        }
+      }
+      return slot;
+    }
+
+    // 调用者持锁并处于 WriteScope 内, key 不存在
+    void insertNew(size_t hash, const K &key, const V &value)
+    {
+      if ((table->used + 1) * 4 > table->capacity() * 3)
+      {
+        grow();
+      }
+      Slot *slot = table->emptySlot(hash);
+      if (slot->state == kEmpty)
+      {
+        ++table->used;
+      }
+      slot->hash = hash;
+      slot->key = key;
+      slot->value = value;
+      slot->state = kFull;
+      detail::relaxedAdd(&size, static_cast<size_t>(1));
+      migrate(kMigrateBatch);
+    }
+
+    Slot *moveToTable(Slot *stale)
+    {
+      Slot *slot = table->emptySlot(stale->hash);
+      if (slot->state == kEmpty)
+      {
+        ++table->used;
+      }
+      slot->hash = stale->hash;
+      slot->key = stale->key;
+      slot->value = stale->value;
+      slot->state = kFull;
+      stale->state = kDeleted;
+      return slot;
+    }
+
+    // 搬迁旧表中最多 batch 个槽位, 旧表搬空后退役
+    void migrate(size_t batch)
+    {
+      if (old == NULL)
+      {
+        return;
+      }
+      size_t capacity = old->capacity();
+      for (size_t n = 0; n < batch && migrateIndex < capacity; ++n, ++migrateIndex)
+      {
+        Slot &slot = old->slots[migrateIndex];
+        if (slot.state == kFull)
+        {
+          moveToTable(&slot);
+        }
+      }
+      if (migrateIndex == capacity)
+      {
+        retired.push_back(old);
+        detail::atomicStore(&old, static_cast<Table *>(NULL), __ATOMIC_RELEASE);
+        migrateIndex = 0;
+      }
+    }
+
+    void grow()
+    {
+      // 上一轮还没搬完, 先一次搬完 (新表是旧表的两倍, 这种情况很少)
+      if (old != NULL)
+      {
+        migrate(old->capacity());
+      }
+      // 墓碑多时原地重建, 不分配新表
+      size_t capacity = table->capacity();
+      if (size * 2 < capacity)
+      {
+        compact();
+        return;
+      }
+      detail::atomicStore(&old, table, __ATOMIC_RELEASE);
+      detail::atomicStore(&table, new Table(capacity * 2), __ATOMIC_RELEASE);
+      migrateIndex = 0;
+    }
+
+    // 调用者持锁并处于 WriteScope 内, 没有正在搬迁的旧表: 清掉墓碑, 存活的元素重新插入
+    void compact()
+    {
+      std::vector<Slot> live;
+      live.reserve(size);
+      size_t capacity = table->capacity();
+      for (size_t i = 0; i < capacity; ++i)
+      {
+        Slot &slot = table->slots[i];
+        if (slot.state == kFull)
+        {
+          live.push_back(slot);
+        }
+        if (slot.state != kEmpty)
+        {
+          slot.state = kEmpty;
+          slot.key = K();
+          slot.value = V();
+        }
+      }
+      table->used = 0;
+      for (size_t i = 0; i < live.size(); ++i)
+      {
+        Slot *slot = table->emptySlot(live[i].hash);
+        slot->hash = live[i].hash;
+        slot->key = live[i].key;
+        slot->value = live[i].value;
+        slot->state = kFull;
+        ++table->used;
+      }
+    }
+  };
+
+  // seqlock 写区间, 可以嵌套 (只有最外层修改版本号)
+  class WriteScope
+  {
+  public:
+    explicit WriteScope(Shard &shard)
+        : shard_(shard),
+          outermost_((shard.version & 1) == 0)
+    {
+      if (outermost_)
+      {
+        detail::atomicStore(&shard_.version, shard_.version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+      }
+    }
+
+    ~WriteScope()
+    {
+      if (outermost_)
+      {
+        detail::atomicStore(&shard_.version, shard_.version + 1, __ATOMIC_RELEASE);
+      }
+    }
+
+  private:
+    Shard &shard_;
+    bool outermost_;
+  };
+
+  static size_t roundUpPowerOfTwo(size_t n)
+  {
+    size_t result = 1;
+    while (result < n)
+    {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  // std::hash 对整数是恒等映射, 再混合一次, 高位选分片, 低位选槽位
+  size_t hashOf(const K &key) const
+  {
+    uint64_t h = static_cast<uint64_t>(hasher_(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+  Shard &shardFor(size_t hash) const
+  {
+    return shards_[(hash >> 40) & (shardCount_ - 1)];
+  }
+
+private:
+  static const bool kOptimisticReads = LockTraits<Mutex>::kThreadSafe &&
+      std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value;
+  static const int kOptimisticRetries = 4;
+  static const size_t kMigrateBatch = 16;
+
+  const size_t shardCount_;
+  Shard *shards_;
+  Hash hasher_;
+  KeyEqual equal_;
+};
+
+__POSIX_THREAD_END
+#endif // !__CONCURRENT_HASH_MAP_H__
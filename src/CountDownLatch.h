@@ -1,6 +1,6 @@
 #ifndef __COUNTDOWNLATCH_H__
 #define __COUNTDOWNLATCH_H__
-#include "posix_port.h"
+#include "LockPolicy.h"
 
 __POSIX_THREAD_BEGIN
 
@@ -17,13 +17,19 @@ __POSIX_THREAD_BEGIN
  *             首先 coundownlatch.Wait()，当主线程调用 CountDown() 时，计数器变为0，多个线程同时被唤醒。
  **/
 
-class CountDownLatch
+/**
+ * Mutex 是锁策略 (见 LockPolicy.h), 条件变量随之选择。CountDownLatch 即 BasicCountDownLatch<MutexLock>,
+ * 单线程的批处理工具可以用 BasicCountDownLatch<NullMutex>, 计数时不加锁也不调用 pthread_cond_broadcast
+ * (计数未归零时 Wait() 会报错退出, 因为单线程中不会有别人 CountDown)。
+ **/
+template <typename Mutex>
+class BasicCountDownLatch
 {
 public:
-  CountDownLatch(const CountDownLatch &latch) = delete;
-  CountDownLatch &operator=(const CountDownLatch &latch) = delete;
+  BasicCountDownLatch(const BasicCountDownLatch &latch) = delete;
+  BasicCountDownLatch &operator=(const BasicCountDownLatch &latch) = delete;
 
-  explicit CountDownLatch(int count);
+  explicit BasicCountDownLatch(int count);
 
   void Wait();
 
@@ -32,10 +38,52 @@ public:
   int GetCount() const;
 
 private:
-  mutable MutexLock mutex_;
-  Condition condition_;
+  mutable Mutex mutex_;
+  typename LockTraits<Mutex>::Condition condition_;
   int count_;
 };
 
+template <typename Mutex>
+BasicCountDownLatch<Mutex>::BasicCountDownLatch(int count)
+    : mutex_(),
+      condition_(mutex_),
+      count_(count)
+{
+}
+
+template <typename Mutex>
+void BasicCountDownLatch<Mutex>::Wait()
+{
+  MutexLockGuard<Mutex> lock(mutex_);
+
+  while (count_ > 0)
+  {
+    condition_.Wait();
+  }
+}
+
+template <typename Mutex>
+void BasicCountDownLatch<Mutex>::CountDown()
+{
+  MutexLockGuard<Mutex> lock(mutex_);
+  --count_;
+
+  if (count_ == 0)
+  {
+    condition_.SignalAll();
+  }
+}
+
+template <typename Mutex>
+int BasicCountDownLatch<Mutex>::GetCount() const
+{
+  MutexLockGuard<Mutex> lock(mutex_);
+  return count_;
+}
+
+// 最常用的 MutexLock 版本在库中显式实例化, 使用者不必各自再实例化一份
+extern template class BasicCountDownLatch<MutexLock>;
+typedef BasicCountDownLatch<MutexLock> CountDownLatch;
+
 __POSIX_THREAD_END
-#endif // __COUNTDOWNLATCH_H__
\ No newline at end of file
+#endif // __COUNTDOWNLATCH_H__
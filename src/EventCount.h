@@ -0,0 +1,135 @@
+#ifndef __EVENT_COUNT_H__
+#define __EVENT_COUNT_H__
+
+#include "Atomic.h"
+#include "Futex.h"
+#include <limits.h>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * EventCount (参考 folly::EventCount), 给 lock-free 结构用的 "条件变量"。
+ *
+ *  Condition 要求等待者持有 MutexLock, Signal()/SignalAll() 不管有没有人等待都要调用
+ *  pthread_cond_signal/broadcast. EventCount 不需要锁: 一个 64 位原子变量, 高 32 位是 epoch,
+ *  低 32 位是等待者个数。没有等待者时 notify() 只有一次 load, 不会进入内核。
+ *
+ *  等待端:
+ *    if (queue.tryPop(item)) return;
+ *    for (;;)
+ *    {
+ *      EventCount::Key key = ec.prepareWait();
+ *      if (queue.tryPop(item)) { ec.cancelWait(); break; }
+ *      ec.commitWait(key);
+ *    }
+ *
+ *  通知端:
+ *    queue.push(item);
+ *    ec.notify();
+ *
+ *  prepareWait() 之后发生的 notify() 都会改变 epoch, commitWait(key) 发现 epoch 变化就不会睡眠,
+ *  所以在 prepareWait() 与 commitWait() 之间检查条件不会丢失唤醒。
+ *  futex 等待的是 epoch 所在的 32 位, 这里假定小端 (x86/ARM)。
+ */
+class EventCount
+{
+public:
+  class Key
+  {
+    friend class EventCount;
+    explicit Key(uint32_t epoch) : epoch_(epoch) {}
+    uint32_t epoch_;
+  };
+
+  EventCount(const EventCount &ec) = delete;
+  EventCount &operator=(const EventCount &ec) = delete;
+
+  EventCount()
+      : val_(0)
+  {
+  }
+
+  // 无等待者时: 一个 StoreLoad 屏障 + 一次 load.
+  // 屏障保证调用者在 notify() 之前对条件的修改, 先于这里对等待者个数的读取, 与 prepareWait() 配对
+  void notify()
+  {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (unlikely(detail::atomicLoad(&val_, __ATOMIC_RELAXED) & kWaiterMask))
+    {
+      doNotify(1);
+    }
+  }
+
+  void notifyAll()
+  {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (unlikely(detail::atomicLoad(&val_, __ATOMIC_RELAXED) & kWaiterMask))
+    {
+      doNotify(INT_MAX);
+    }
+  }
+
+  Key prepareWait()
+  {
+    uint64_t prev = detail::atomicFetchAdd(&val_, kAddWaiter);
+    return Key(static_cast<uint32_t>(prev >> kEpochShift));
+  }
+
+  void cancelWait()
+  {
+    detail::atomicFetchAdd(&val_, kSubWaiter);
+  }
+
+  void commitWait(Key key)
+  {
+    while (static_cast<uint32_t>(detail::atomicLoad(&val_, __ATOMIC_ACQUIRE) >> kEpochShift) == key.epoch_)
+    {
+      detail::futexWait(epochAddress(), key.epoch_);
+    }
+    detail::atomicFetchAdd(&val_, kSubWaiter);
+  }
+
+  // 等待直到 condition() 返回 true
+  template <typename Predicate>
+  void await(Predicate condition)
+  {
+    if (condition())
+    {
+      return;
+    }
+    for (;;)
+    {
+      Key key = prepareWait();
+      if (condition())
+      {
+        cancelWait();
+        break;
+      }
+      commitWait(key);
+    }
+  }
+
+private:
+  void doNotify(int count)
+  {
+    detail::atomicFetchAdd(&val_, kAddEpoch);
+    detail::futexWake(epochAddress(), count);
+  }
+
+  uint32_t *epochAddress()
+  {
+    return reinterpret_cast<uint32_t *>(&val_) + 1;
+  }
+
+private:
+  static const uint64_t kAddWaiter = 1;
+  static const uint64_t kSubWaiter = static_cast<uint64_t>(-1);
+  static const int kEpochShift = 32;
+  static const uint64_t kAddEpoch = static_cast<uint64_t>(1) << kEpochShift;
+  static const uint64_t kWaiterMask = kAddEpoch - 1;
+
+  uint64_t val_;
+};
+
+__POSIX_THREAD_END
+#endif // !__EVENT_COUNT_H__
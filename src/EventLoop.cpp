@@ -0,0 +1,258 @@
+#include "EventLoop.h"
+#include "Channel.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace
+{
+
+__thread EventLoop *t_loopInThisThread = NULL;
+
+const int kPollTimeMs = 10000;
+const int kInitEventListSize = 16;
+
+int createEventfd()
+{
+  int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0)
+  {
+    fprintf(stderr, "File:%s, Line:%d, eventfd: %s\n", __FILE__, __LINE__, strerror(errno));
+    abort();
+  }
+  return fd;
+}
+
+} // namespace
+
+EventLoop *EventLoop::getEventLoopOfCurrentThread()
+{
+  return t_loopInThisThread;
+}
+
+EventLoop::EventLoop()
+    : looping_(false),
+      quit_(false),
+      eventHandling_(false),
+      iteration_(0),
+      threadId_(CurrentThread::tid()),
+      epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
+      wakeupFd_(createEventfd()),
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      events_(kInitEventListSize),
+      wakeupPending_(false)
+{
+  if (epollfd_ < 0)
+  {
+    fprintf(stderr, "File:%s, Line:%d, epoll_create1: %s\n", __FILE__, __LINE__, strerror(errno));
+    abort();
+  }
+  if (t_loopInThisThread)
+  {
+    fprintf(stderr, "Another EventLoop %p exists in this thread %d\n", t_loopInThisThread, threadId_);
+    abort();
+  }
+  t_loopInThisThread = this;
+
+  wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleWakeup, this));
+  wakeupChannel_->enableReading();
+}
+
+EventLoop::~EventLoop()
+{
+  wakeupChannel_->disableAll();
+  wakeupChannel_->remove();
+  ::close(wakeupFd_);
+  ::close(epollfd_);
+  t_loopInThisThread = NULL;
+}
+
+void EventLoop::loop()
+{
+  assert(!looping_);
+  assertInLoopThread();
+  looping_ = true;
+  quit_ = false;
+
+  while (!quit_)
+  {
+    int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), kPollTimeMs);
+    if (numEvents < 0 && errno != EINTR)
+    {
+      fprintf(stderr, "File:%s, Line:%d, epoll_wait: %s\n", __FILE__, __LINE__, strerror(errno));
+    }
+    ++iteration_;
+
+    eventHandling_ = true;
+    for (int i = 0; i < numEvents; ++i)
+    {
+      Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
+      channel->setRevents(events_[i].events);
+      channel->handleEvent();
+    }
+    eventHandling_ = false;
+
+    if (numEvents == static_cast<int>(events_.size()))
+    {
+      events_.resize(events_.size() * 2);
+    }
+    doPendingFunctors();
+  }
+
+  looping_ = false;
+}
+
+void EventLoop::quit()
+{
+  quit_ = true;
+  // 在其他线程调用时, loop 可能阻塞在 epoll_wait 中
+  if (!isInLoopThread())
+  {
+    wakeup();
+  }
+}
+
+void EventLoop::runInLoop(Functor cb)
+{
+  if (isInLoopThread())
+  {
+    cb();
+  }
+  else
+  {
+    queueInLoop(std::move(cb));
+  }
+}
+
+void EventLoop::queueInLoop(Functor cb)
+{
+  bool needWakeup = false;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    pendingFunctors_.push_back(std::move(cb));
+    // loop 线程在处理事件时排队的回调, 本轮结束前就会执行, 不需要唤醒;
+    // 正在执行回调时或者 loop() 之外排队的, 要等下一轮, 需要唤醒
+    if (!wakeupPending_ && (!isInLoopThread() || !eventHandling_))
+    {
+      wakeupPending_ = true;
+      needWakeup = true;
+    }
+  }
+
+  if (needWakeup)
+  {
+    wakeup();
+  }
+}
+
+size_t EventLoop::queueSize() const
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  return pendingFunctors_.size();
+}
+
+void EventLoop::updateChannel(Channel *channel)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  if (!channel->addedToLoop())
+  {
+    assert(channels_.find(channel->fd()) == channels_.end());
+    channels_[channel->fd()] = channel;
+    channel->setAddedToLoop(true);
+    epollControl(EPOLL_CTL_ADD, channel);
+  }
+  else
+  {
+    epollControl(EPOLL_CTL_MOD, channel);
+  }
+}
+
+void EventLoop::removeChannel(Channel *channel)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  assert(channels_.find(channel->fd()) != channels_.end());
+  channels_.erase(channel->fd());
+  if (channel->addedToLoop())
+  {
+    epollControl(EPOLL_CTL_DEL, channel);
+    channel->setAddedToLoop(false);
+  }
+}
+
+bool EventLoop::hasChannel(Channel *channel)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  std::map<int, Channel *>::const_iterator it = channels_.find(channel->fd());
+  return it != channels_.end() && it->second == channel;
+}
+
+void EventLoop::epollControl(int operation, Channel *channel)
+{
+  struct epoll_event event;
+  ::memset(&event, 0, sizeof event);
+  // 边沿触发, 见 Channel 的说明
+  event.events = channel->events() | EPOLLET;
+  event.data.ptr = channel;
+  if (::epoll_ctl(epollfd_, operation, channel->fd(), &event) < 0)
+  {
+    fprintf(stderr, "File:%s, Line:%d, epoll_ctl op=%d fd=%d: %s\n",
+            __FILE__, __LINE__, operation, channel->fd(), strerror(errno));
+    if (operation != EPOLL_CTL_DEL)
+    {
+      abort();
+    }
+  }
+}
+
+void EventLoop::abortNotInLoopThread()
+{
+  fprintf(stderr, "EventLoop::abortNotInLoopThread - EventLoop %p was created in threadId_ = %d, "
+                  "current thread id = %d\n",
+          this, threadId_, CurrentThread::tid());
+  abort();
+}
+
+void EventLoop::wakeup()
+{
+  uint64_t one = 1;
+  ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+  if (n != sizeof one)
+  {
+    fprintf(stderr, "EventLoop::wakeup() writes %zd bytes instead of 8\n", n);
+  }
+}
+
+void EventLoop::handleWakeup()
+{
+  // 边沿触发, 计数器读一次就清零了
+  uint64_t one = 1;
+  ssize_t n = ::read(wakeupFd_, &one, sizeof one);
+  (void)n;
+}
+
+void EventLoop::doPendingFunctors()
+{
+  std::vector<Functor> functors;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    functors.swap(pendingFunctors_);
+    wakeupPending_ = false;
+  }
+
+  for (size_t i = 0; i < functors.size(); ++i)
+  {
+    functors[i]();
+  }
+}
+
+__POSIX_THREAD_END
@@ -0,0 +1,93 @@
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include "posix_thread.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+struct epoll_event;
+
+__POSIX_THREAD_BEGIN
+
+class Channel;
+
+/**
+ * EventLoop (参考 muduo net::EventLoop), one loop per thread.
+ *
+ *  每个线程最多一个 EventLoop, 用 epoll 同时等待多个 fd (pipe, eventfd, timerfd, 本地 socket 等),
+ *  不必为每个 fd 单独占用一个线程。EventLoop 拥有的对象 (Channel) 只能在 loop 所在的线程访问,
+ *  通过 CurrentThread::tid() 检查, 跨线程访问直接 abort。
+ *
+ *  其他线程想让 loop 做事情, 调用 runInLoop()/queueInLoop(): 回调放进带锁的 pendingFunctors_,
+ *  再写 eventfd 唤醒 epoll_wait。loop 每轮把整个队列 swap 出来批量执行, 缩短临界区,
+ *  也避免回调里再次 queueInLoop() 造成死锁。上一次唤醒还没被处理时不重复写 eventfd。
+ */
+class EventLoop
+{
+public:
+  using Functor = std::function<void()>;
+
+  EventLoop(const EventLoop &loop) = delete;
+  EventLoop &operator=(const EventLoop &loop) = delete;
+
+  EventLoop();
+  ~EventLoop(); // force out-line dtor, for std::unique_ptr members.
+
+  // 必须在创建 loop 的线程调用
+  void loop();
+  // 可以跨线程调用, 当前这轮事件处理完之后退出
+  void quit();
+
+  uint64_t iteration() const { return iteration_; }
+
+  // 在 loop 线程中执行 cb: 当前就在 loop 线程则立即执行, 否则排队并唤醒 loop
+  void runInLoop(Functor cb);
+  // 排队到 loop 线程下一轮执行, 可以跨线程调用
+  void queueInLoop(Functor cb);
+  size_t queueSize() const;
+
+  // internal usage
+  void wakeup();
+  void updateChannel(Channel *channel);
+  void removeChannel(Channel *channel);
+  bool hasChannel(Channel *channel);
+
+  void assertInLoopThread()
+  {
+    if (!isInLoopThread())
+    {
+      abortNotInLoopThread();
+    }
+  }
+  bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
+  bool eventHandling() const { return eventHandling_; }
+
+  static EventLoop *getEventLoopOfCurrentThread();
+
+private:
+  void abortNotInLoopThread();
+  void handleWakeup();
+  void doPendingFunctors();
+  void epollControl(int operation, Channel *channel);
+
+private:
+  bool looping_;
+  volatile bool quit_;
+  bool eventHandling_;
+  uint64_t iteration_;
+  const pid_t threadId_;
+
+  int epollfd_;
+  int wakeupFd_;
+  std::unique_ptr<Channel> wakeupChannel_;
+  std::vector<struct epoll_event> events_;
+  std::map<int, Channel *> channels_;
+
+  mutable MutexLock mutex_;
+  bool wakeupPending_;                  // guarded by mutex_, eventfd 已写入但 loop 还没取走回调
+  std::vector<Functor> pendingFunctors_; // guarded by mutex_
+};
+
+__POSIX_THREAD_END
+#endif // !__EVENT_LOOP_H__
@@ -0,0 +1,67 @@
+#include "EventLoopThread.h"
+#include "EventLoop.h"
+#include <assert.h>
+
+__POSIX_THREAD_BEGIN
+
+EventLoopThread::EventLoopThread(const ThreadInitCallback &cb, const std::string &name)
+    : loop_(NULL),
+      exiting_(false),
+      thread_(std::bind(&EventLoopThread::threadFunc, this), name),
+      mutex_(),
+      cond_(mutex_),
+      callback_(cb)
+{
+}
+
+EventLoopThread::~EventLoopThread()
+{
+  exiting_ = true;
+  // not 100% race-free, eg. threadFunc could be running callback_.
+  // still a tiny chance to call destructed object, if threadFunc exits just now.
+  // but when EventLoopThread destructs, usually programming is exiting anyway.
+  if (loop_ != NULL)
+  {
+    loop_->quit();
+    thread_.join();
+  }
+}
+
+EventLoop *EventLoopThread::startLoop()
+{
+  assert(!thread_.started());
+  thread_.start();
+
+  EventLoop *loop = NULL;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    while (loop_ == NULL)
+    {
+      cond_.Wait();
+    }
+    loop = loop_;
+  }
+  return loop;
+}
+
+void EventLoopThread::threadFunc()
+{
+  EventLoop loop;
+
+  if (callback_)
+  {
+    callback_(&loop);
+  }
+
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    loop_ = &loop;
+    cond_.Signal();
+  }
+
+  loop.loop();
+  MutexLockGuard<MutexLock> lock(mutex_);
+  loop_ = NULL;
+}
+
+__POSIX_THREAD_END
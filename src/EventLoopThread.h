@@ -0,0 +1,42 @@
+#ifndef __EVENT_LOOP_THREAD_H__
+#define __EVENT_LOOP_THREAD_H__
+
+#include "posix_thread.h"
+
+__POSIX_THREAD_BEGIN
+
+class EventLoop;
+
+/**
+ * EventLoopThread: 启动一个 Thread, 在线程函数中创建 EventLoop 并运行 loop()。
+ *  startLoop() 等到 loop 创建好之后才返回, 之后可以通过 runInLoop()/queueInLoop() 把任务交给它。
+ *  析构时让 loop 退出并 join 线程。
+ */
+class EventLoopThread
+{
+public:
+  using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+  EventLoopThread(const EventLoopThread &thread) = delete;
+  EventLoopThread &operator=(const EventLoopThread &thread) = delete;
+
+  explicit EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(),
+                           const std::string &name = std::string());
+  ~EventLoopThread();
+
+  EventLoop *startLoop();
+
+private:
+  void threadFunc();
+
+private:
+  EventLoop *loop_; // guarded by mutex_
+  bool exiting_;
+  Thread thread_;
+  MutexLock mutex_;
+  Condition cond_;
+  ThreadInitCallback callback_;
+};
+
+__POSIX_THREAD_END
+#endif // !__EVENT_LOOP_THREAD_H__
@@ -0,0 +1,88 @@
+#include "EventLoopThreadPool.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include <assert.h>
+#include <stdio.h>
+
+__POSIX_THREAD_BEGIN
+
+EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &name)
+    : baseLoop_(baseLoop),
+      name_(name),
+      started_(false),
+      numThreads_(0),
+      next_(0)
+{
+}
+
+EventLoopThreadPool::~EventLoopThreadPool()
+{
+  // Don't delete loop, it's stack variable
+}
+
+void EventLoopThreadPool::start(const ThreadInitCallback &cb)
+{
+  assert(!started_);
+  baseLoop_->assertInLoopThread();
+
+  started_ = true;
+
+  for (int i = 0; i < numThreads_; ++i)
+  {
+    char id[32];
+    snprintf(id, sizeof id, "%d", i);
+    EventLoopThread *t = new EventLoopThread(cb, name_ + id);
+    threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+    loops_.push_back(t->startLoop());
+  }
+  if (numThreads_ == 0 && cb)
+  {
+    cb(baseLoop_);
+  }
+}
+
+EventLoop *EventLoopThreadPool::getNextLoop()
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  EventLoop *loop = baseLoop_;
+
+  if (!loops_.empty())
+  {
+    loop = loops_[next_];
+    ++next_;
+    if (static_cast<size_t>(next_) >= loops_.size())
+    {
+      next_ = 0;
+    }
+  }
+  return loop;
+}
+
+EventLoop *EventLoopThreadPool::getLoopForHash(size_t hashCode)
+{
+  baseLoop_->assertInLoopThread();
+  EventLoop *loop = baseLoop_;
+
+  if (!loops_.empty())
+  {
+    loop = loops_[hashCode % loops_.size()];
+  }
+  return loop;
+}
+
+std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  if (loops_.empty())
+  {
+    return std::vector<EventLoop *>(1, baseLoop_);
+  }
+  else
+  {
+    return loops_;
+  }
+}
+
+__POSIX_THREAD_END
@@ -0,0 +1,54 @@
+#ifndef __EVENT_LOOP_THREAD_POOL_H__
+#define __EVENT_LOOP_THREAD_POOL_H__
+
+#include "posix_define.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+__POSIX_THREAD_BEGIN
+
+class EventLoop;
+class EventLoopThread;
+
+/**
+ * EventLoopThreadPool: 多个 EventLoopThread, 按轮询或者哈希把工作分配给各个 loop。
+ *  setThreadNum(0) 时所有工作都在 baseLoop 中完成。
+ *  除了 start() 之外, 其余成员函数只能在 baseLoop 所在的线程调用。
+ */
+class EventLoopThreadPool
+{
+public:
+  using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+  EventLoopThreadPool(const EventLoopThreadPool &pool) = delete;
+  EventLoopThreadPool &operator=(const EventLoopThreadPool &pool) = delete;
+
+  EventLoopThreadPool(EventLoop *baseLoop, const std::string &name);
+  ~EventLoopThreadPool();
+
+  void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+  void start(const ThreadInitCallback &cb = ThreadInitCallback());
+
+  // round-robin
+  EventLoop *getNextLoop();
+  // 相同的 hashCode 总是得到同一个 loop
+  EventLoop *getLoopForHash(size_t hashCode);
+  std::vector<EventLoop *> getAllLoops();
+
+  bool started() const { return started_; }
+  const std::string &name() const { return name_; }
+
+private:
+  EventLoop *baseLoop_;
+  std::string name_;
+  bool started_;
+  int numThreads_;
+  int next_;
+  std::vector<std::unique_ptr<EventLoopThread>> threads_;
+  std::vector<EventLoop *> loops_;
+};
+
+__POSIX_THREAD_END
+#endif // !__EVENT_LOOP_THREAD_POOL_H__
@@ -0,0 +1,266 @@
+#include "FastClock.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef POSIX_THREAD_HAS_TSC
+#include <cpuid.h>
+#endif
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// 全 0 即 "未初始化", 静态初始化阶段就可以安全使用
+FastClockState g_fastClock;
+
+} // namespace detail
+
+namespace
+{
+
+const int64_t kCalibrateNanos = 2 * 1000 * 1000;        // 启动时校准 2ms
+const int64_t kRecalibrateNanos = 1000 * 1000 * 1000;   // 之后每秒校准一次
+const int64_t kStepNanos = 1000 * 1000;                 // 落后 CLOCK_MONOTONIC 超过 1ms 直接向前跳
+const double kMaxSlew = 0.01;                           // slew 最多把倍率调整 1%
+const int64_t kUnstableNanos = 50 * 1000 * 1000;        // 一个周期内偏差超过 50ms 认为 TSC 不可靠
+const int kMaxUnstable = 3;
+const int kPairSamples = 5;                             // 每次取 TSC/CLOCK_MONOTONIC 读数对时尝试的次数
+
+pthread_once_t g_once = PTHREAD_ONCE_INIT;
+int g_unstable = 0; // 只在持有 updating 时修改
+
+#ifdef POSIX_THREAD_HAS_TSC
+
+bool hasInvariantTsc()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+  {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1 << 8)) != 0;
+}
+
+// 内核在检测到 TSC 不同步或者不稳定时会把时钟源切换为 hpet/acpi_pm 等, 读不到文件时不作判断
+bool kernelTrustsTsc()
+{
+  FILE *file = ::fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+  if (file == NULL)
+  {
+    return true;
+  }
+  char name[64] = {0};
+  bool trusted = ::fgets(name, sizeof name, file) == NULL || ::strncmp(name, "tsc", 3) == 0;
+  ::fclose(file);
+  return trusted;
+}
+
+// 取一对尽量同时的 (TSC, CLOCK_MONOTONIC) 读数, TSC 取 clock_gettime 前后两次读数的中点.
+// 两次读数之间被抢占时中点可能偏差几毫秒 (重新校准会据此向前跳), 所以读几次, 取间隔最短的一次
+void readPair(uint64_t *ticks, int64_t *nanos)
+{
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < kPairSamples; ++i)
+  {
+    uint64_t before = __rdtsc();
+    int64_t now = PosixThread::FastClock::monotonicNanos();
+    uint64_t after = __rdtsc();
+    if (after - before < best)
+    {
+      best = after - before;
+      *ticks = before + (after - before) / 2;
+      *nanos = now;
+    }
+  }
+}
+
+void publish(uint64_t baseTicks, int64_t baseNanos, double nanosPerTick, double slew)
+{
+  detail::FastClockState &state = detail::g_fastClock;
+  uint32_t version = detail::atomicLoad(&state.version, __ATOMIC_RELAXED);
+  detail::atomicStore(&state.version, version + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  detail::atomicStore(&state.baseTicks, baseTicks, __ATOMIC_RELAXED);
+  detail::atomicStore(&state.baseNanos, baseNanos, __ATOMIC_RELAXED);
+  detail::atomicStore(&state.mult, static_cast<uint64_t>(nanosPerTick * (1ULL << FastClock::kShift)), __ATOMIC_RELAXED);
+  detail::atomicStore(&state.slewMult, static_cast<uint64_t>(nanosPerTick * (1.0 + slew) * (1ULL << FastClock::kShift)),
+                      __ATOMIC_RELAXED);
+  detail::atomicStore(&state.recalTicks, static_cast<uint64_t>(kRecalibrateNanos / nanosPerTick), __ATOMIC_RELAXED);
+  detail::atomicStore(&state.version, version + 2, __ATOMIC_RELEASE);
+}
+
+bool calibrate()
+{
+  detail::FastClockState &state = detail::g_fastClock;
+  uint64_t startTicks, endTicks;
+  int64_t startNanos, endNanos;
+  readPair(&startTicks, &startNanos);
+  do
+  {
+    readPair(&endTicks, &endNanos);
+  } while (endNanos - startNanos < kCalibrateNanos);
+
+  if (endTicks <= startTicks)
+  {
+    return false;
+  }
+  double nanosPerTick = static_cast<double>(endNanos - startNanos) / (endTicks - startTicks);
+  // 合理的 TSC 频率在 100MHz ~ 10GHz 之间
+  if (nanosPerTick < 0.1 || nanosPerTick > 10.0)
+  {
+    return false;
+  }
+  state.calibTicks = startTicks;
+  state.calibNanos = startNanos;
+  publish(endTicks, endNanos, nanosPerTick, 0.0);
+  return true;
+}
+
+#endif // POSIX_THREAD_HAS_TSC
+
+// 把 lastNanos 提高到 nanos (已经更大时不变), 返回提高之后的值
+int64_t raiseLastNanos(int64_t nanos)
+{
+  detail::FastClockState &state = detail::g_fastClock;
+  int64_t last = detail::atomicLoad(&state.lastNanos, __ATOMIC_ACQUIRE);
+  while (nanos > last)
+  {
+    if (detail::atomicCompareExchange(&state.lastNanos, last, nanos, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      return nanos;
+    }
+  }
+  return last;
+}
+
+void initialize()
+{
+  int mode = FastClock::kMonotonic;
+#ifdef POSIX_THREAD_HAS_TSC
+  const char *env = ::getenv("POSIX_THREAD_FAST_CLOCK");
+  bool forced = env != NULL && ::strcmp(env, "monotonic") == 0;
+  if (!forced && hasInvariantTsc() && kernelTrustsTsc() && calibrate())
+  {
+    mode = FastClock::kTsc;
+  }
+#endif
+  detail::atomicStore(&detail::g_fastClock.mode, mode, __ATOMIC_RELEASE);
+}
+
+} // namespace
+
+FastClock::Mode FastClock::mode()
+{
+  int mode = detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE);
+  if (unlikely(mode == 0))
+  {
+    ::pthread_once(&g_once, initialize);
+    mode = detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE);
+  }
+  return static_cast<Mode>(mode);
+}
+
+double FastClock::ticksPerSecond()
+{
+  if (mode() != kTsc)
+  {
+    return 1e9;
+  }
+  uint64_t mult = detail::atomicLoad(&detail::g_fastClock.mult, __ATOMIC_RELAXED);
+  return 1e9 * (1ULL << kShift) / static_cast<double>(mult);
+}
+
+#ifdef POSIX_THREAD_HAS_TSC
+int64_t FastClock::convertLocked(uint64_t ticks)
+{
+  detail::FastClockState &state = detail::g_fastClock;
+  int64_t delta = static_cast<int64_t>(ticks - state.baseTicks);
+  return state.baseNanos + scale(delta, state.mult, state.slewMult, state.recalTicks);
+}
+#endif
+
+int64_t FastClock::slowTicks()
+{
+#ifdef POSIX_THREAD_HAS_TSC
+  if (mode() == kTsc)
+  {
+    return static_cast<int64_t>(__rdtsc());
+  }
+#endif
+  return monotonicNanos();
+}
+
+int64_t FastClock::slowNanos()
+{
+#ifdef POSIX_THREAD_HAS_TSC
+  if (mode() == kTsc)
+  {
+    return toNanos(__rdtsc());
+  }
+#endif
+  int64_t now = monotonicNanos();
+  if (likely(detail::atomicLoad(&detail::g_fastClock.lastNanos, __ATOMIC_ACQUIRE) == 0))
+  {
+    return now;
+  }
+  return raiseLastNanos(now);
+}
+
+// 保持换算结果连续: 新的基准点取旧参数在此刻的换算值, 与 CLOCK_MONOTONIC 之间的偏差通过调整倍率在下一个周期内吸收
+void FastClock::recalibrate()
+{
+#ifdef POSIX_THREAD_HAS_TSC
+  detail::FastClockState &state = detail::g_fastClock;
+  int expected = 0;
+  if (mode() != kTsc || !detail::atomicCompareExchange(&state.updating, expected, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    return;
+  }
+
+  uint64_t ticks;
+  int64_t actual;
+  readPair(&ticks, &actual);
+  // 只有持有 updating 的线程修改参数, 这里不需要 seqlock 重试
+  int64_t predicted = convertLocked(ticks);
+  int64_t error = actual - predicted;
+
+  if (error > kUnstableNanos || error < -kUnstableNanos)
+  {
+    if (++g_unstable >= kMaxUnstable)
+    {
+      fprintf(stderr, "File:%s, Line:%d, Function:%s, TSC drifts %lld ns from CLOCK_MONOTONIC, fall back to clock_gettime\n",
+              __FILE__, __LINE__, __FUNCTION__, static_cast<long long>(error));
+      // 切换之前记录一次 TSC 的换算值, 切换之后的读者一定能看到非 0 的 lastNanos;
+      // 切换之后再记录一次, 覆盖切换前一刻别的线程还在用 TSC 换算出的值
+      raiseLastNanos(convertLocked(__rdtsc()));
+      detail::atomicStore(&state.mode, static_cast<int>(kMonotonic), __ATOMIC_RELEASE);
+      raiseLastNanos(convertLocked(__rdtsc()));
+    }
+  }
+  else
+  {
+    g_unstable = 0;
+  }
+
+  double nanosPerTick = static_cast<double>(actual - state.calibNanos) / (ticks - state.calibTicks);
+  int64_t base = predicted;
+  double slew = 0.0;
+  if (error > kStepNanos)
+  {
+    // 落后太多 (例如虚拟机被暂停过), 直接向前跳, 仍然单调
+    base = actual;
+  }
+  else
+  {
+    slew = static_cast<double>(error) / kRecalibrateNanos;
+    slew = slew > kMaxSlew ? kMaxSlew : (slew < -kMaxSlew ? -kMaxSlew : slew);
+  }
+  publish(ticks, base, nanosPerTick, slew);
+  detail::atomicStore(&state.updating, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+__POSIX_THREAD_END
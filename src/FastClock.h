@@ -0,0 +1,197 @@
+#ifndef __FAST_CLOCK_H__
+#define __FAST_CLOCK_H__
+
+#include "Atomic.h"
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define POSIX_THREAD_HAS_TSC 1
+#endif
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// 时钟换算参数, 由 seqlock 保护: 写者修改期间 version 为奇数, 读者前后两次读到同一个偶数才采信
+struct FastClockState
+{
+  int mode;           // 0: 未初始化, FastClock::kTsc, FastClock::kMonotonic
+  uint32_t version;
+  uint64_t baseTicks;  // 换算基准点的 TSC 读数
+  int64_t baseNanos;   // 基准点对应的纳秒数 (CLOCK_MONOTONIC 的时间轴)
+  uint64_t mult;       // 每个 tick 的纳秒数 * 2^kShift (长期平均频率)
+  uint64_t slewMult;   // 基准点之后 recalTicks 以内使用的倍率, 用来吸收与 CLOCK_MONOTONIC 之间的偏差
+  uint64_t recalTicks; // 距离基准点超过这么多 tick 就重新校准
+  int updating;        // 正在重新校准, 只允许一个线程做
+  uint64_t calibTicks; // 最初校准的起点, 用于计算长期平均频率
+  int64_t calibNanos;
+  int64_t lastNanos;   // 运行中退化之后 nowNanos() 返回过的最大值, 0 表示没有发生过运行中的退化
+};
+
+extern FastClockState g_fastClock;
+
+} // namespace detail
+
+/**
+ * FastClock: 比 clock_gettime 更便宜的单调时钟, 用于任务/锁的耗时统计、trace、定时器等。
+ *
+ *  clock_gettime(CLOCK_MONOTONIC) 走 vDSO 也要 20~30ns, 在一些虚拟机上 (时钟源不是 tsc) 会陷入内核,
+ *  每个任务、每次加锁读两次时钟就太贵了。FastClock 直接读 TSC (rdtsc, 几纳秒), 换算成纳秒:
+ *
+ *  - 第一次使用时用 CLOCK_MONOTONIC 校准 TSC 的频率, 换算结果与 CLOCK_MONOTONIC 在同一时间轴上,
+ *    可以与 clock_gettime 的结果直接比较或相减。
+ *  - 距离上次校准超过约 1 秒时, 读时钟的线程顺带重新校准, 再用新的参数换算: 按长期平均频率修正倍率,
+ *    并在下一个周期内逐渐吸收与 CLOCK_MONOTONIC 之间的偏差 (slew, 而不是直接跳变), 所以结果单调不减。
+ *    slew 之后的倍率只用于基准点之后的一个周期, 超过的部分 (例如长时间没有人读时钟) 按平均频率换算,
+ *    偏差不会随空闲时间累积。
+ *  - CPU 不支持 invariant TSC (CPUID 0x80000007 EDX bit 8), 内核的时钟源不是 tsc (内核认为 TSC 不可靠),
+ *    校准结果不合理, 或者运行中偏差大到无法通过 slew 吸收时, 退化为 clock_gettime(CLOCK_MONOTONIC)。
+ *    也可以设置环境变量 POSIX_THREAD_FAST_CLOCK=monotonic 强制退化。
+ *  - 运行中退化时 TSC 的换算值可能已经比 CLOCK_MONOTONIC 快, 此后 nowNanos() 不小于退化前返回过的值
+ *    (与记录的最大值比较, 用 CAS 更新), 直到 CLOCK_MONOTONIC 追上来为止, 所以仍然单调不减。
+ *
+ *  ticks()/ticksOrdered() 是原始读数 (退化时就是纳秒), 用 toNanos()/ticksToNanos() 换算, 只在同一个时钟源下有意义:
+ *  退化之前取的 ticks 在退化之后会被当成纳秒, 跨越时钟源切换的区间要用 nowNanos() 测量;
+ *  测量一小段代码时, 结束点用 ticksOrdered() (rdtscp), 保证前面的指令执行完才读 TSC。
+ */
+class FastClock
+{
+public:
+  enum Mode
+  {
+    kTsc = 1,
+    kMonotonic = 2,
+  };
+
+  static const int kShift = 32;
+
+  // 纳秒, 与 CLOCK_MONOTONIC 同一时间轴
+  static int64_t nowNanos()
+  {
+#ifdef POSIX_THREAD_HAS_TSC
+    if (likely(detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE) == kTsc))
+    {
+      return toNanos(__rdtsc());
+    }
+    return slowNanos();
+#else
+    return monotonicNanos();
+#endif
+  }
+
+  static uint64_t ticks()
+  {
+#ifdef POSIX_THREAD_HAS_TSC
+    if (likely(detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE) == kTsc))
+    {
+      return __rdtsc();
+    }
+#endif
+    return static_cast<uint64_t>(slowTicks());
+  }
+
+  static uint64_t ticksOrdered()
+  {
+#ifdef POSIX_THREAD_HAS_TSC
+    if (likely(detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE) == kTsc))
+    {
+      unsigned int aux;
+      return __rdtscp(&aux);
+    }
+#endif
+    return static_cast<uint64_t>(slowTicks());
+  }
+
+  static int64_t toNanos(uint64_t ticks)
+  {
+    detail::FastClockState &state = detail::g_fastClock;
+    if (detail::atomicLoad(&state.mode, __ATOMIC_ACQUIRE) != kTsc)
+    {
+      return static_cast<int64_t>(ticks);
+    }
+    int64_t nanos;
+    if (unlikely(!convert(ticks, &nanos)))
+    {
+      // 重新校准之后用新的参数换算; 别的线程正在校准时旧参数也能给出连续的结果
+      recalibrate();
+      convert(ticks, &nanos);
+    }
+    return nanos;
+  }
+
+  // 两个 ticks 读数之差换算成纳秒
+  static int64_t ticksToNanos(int64_t ticks)
+  {
+    if (detail::atomicLoad(&detail::g_fastClock.mode, __ATOMIC_ACQUIRE) != kTsc)
+    {
+      return ticks;
+    }
+    uint64_t mult = detail::atomicLoad(&detail::g_fastClock.mult, __ATOMIC_RELAXED);
+    return static_cast<int64_t>((static_cast<__int128>(ticks) * mult) >> kShift);
+  }
+
+  static int64_t monotonicNanos()
+  {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+  }
+
+  // 当前使用的时钟源, 第一次调用时完成初始化
+  static Mode mode();
+  // TSC 频率 (退化时为 1e9)
+  static double ticksPerSecond();
+  // 立即与 CLOCK_MONOTONIC 重新校准一次 (平时由 nowNanos() 自动触发)
+  static void recalibrate();
+
+private:
+  // 按 seqlock 读出的参数换算, 距离基准点超过 recalTicks (需要重新校准) 时返回 false
+  static bool convert(uint64_t ticks, int64_t *nanos)
+  {
+    detail::FastClockState &state = detail::g_fastClock;
+    uint64_t baseTicks;
+    int64_t baseNanos;
+    uint64_t mult;
+    uint64_t slewMult;
+    uint64_t recalTicks;
+    while (true)
+    {
+      uint32_t version = detail::atomicLoad(&state.version, __ATOMIC_ACQUIRE);
+      baseTicks = detail::atomicLoad(&state.baseTicks, __ATOMIC_RELAXED);
+      baseNanos = detail::atomicLoad(&state.baseNanos, __ATOMIC_RELAXED);
+      mult = detail::atomicLoad(&state.mult, __ATOMIC_RELAXED);
+      slewMult = detail::atomicLoad(&state.slewMult, __ATOMIC_RELAXED);
+      recalTicks = detail::atomicLoad(&state.recalTicks, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if ((version & 1) == 0 && detail::atomicLoad(&state.version, __ATOMIC_RELAXED) == version)
+      {
+        break;
+      }
+    }
+    // 不同核心的 TSC 可能有很小的偏差, 读数可以略早于基准点
+    int64_t delta = static_cast<int64_t>(ticks - baseTicks);
+    *nanos = baseNanos + scale(delta, mult, slewMult, recalTicks);
+    return delta <= static_cast<int64_t>(recalTicks);
+  }
+
+  // 基准点之后 recalTicks 以内按 slewMult 换算, 超过的部分按 mult 换算
+  static int64_t scale(int64_t delta, uint64_t mult, uint64_t slewMult, uint64_t recalTicks)
+  {
+    int64_t slewed = delta < static_cast<int64_t>(recalTicks) ? delta : static_cast<int64_t>(recalTicks);
+    return static_cast<int64_t>((static_cast<__int128>(slewed) * slewMult) >> kShift) +
+           static_cast<int64_t>((static_cast<__int128>(delta - slewed) * mult) >> kShift);
+  }
+
+  // 用当前参数换算 TSC 读数, 只在持有 updating 时调用
+  static int64_t convertLocked(uint64_t ticks);
+  // 未初始化时完成初始化, 退化模式下返回 monotonicNanos()
+  static int64_t slowTicks();
+  // 同上, 运行中退化之后不小于退化前返回过的值
+  static int64_t slowNanos();
+};
+
+__POSIX_THREAD_END
+#endif // !__FAST_CLOCK_H__
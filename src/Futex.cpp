@@ -0,0 +1,30 @@
+#include "Futex.h"
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+int futexWait(const volatile uint32_t *addr, uint32_t expected,
+              const struct timespec *timeout, bool isPrivate)
+{
+  int op = isPrivate ? (FUTEX_WAIT | FUTEX_PRIVATE_FLAG) : FUTEX_WAIT;
+  long result = ::syscall(SYS_futex, addr, op, expected, timeout, NULL, 0);
+  return result == 0 ? 0 : errno;
+}
+
+int futexWake(const volatile uint32_t *addr, int count, bool isPrivate)
+{
+  int op = isPrivate ? (FUTEX_WAKE | FUTEX_PRIVATE_FLAG) : FUTEX_WAKE;
+  long result = ::syscall(SYS_futex, addr, op, count, NULL, NULL, 0);
+  return result < 0 ? 0 : static_cast<int>(result);
+}
+
+} // namespace detail
+
+__POSIX_THREAD_END
@@ -0,0 +1,28 @@
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include "posix_define.h"
+#include <stdint.h>
+#include <time.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// Linux futex 系统调用的薄封装, glibc 没有提供对应的函数
+//
+// futexWait: 若 *addr == expected 则睡眠, 直到被 futexWake 唤醒, 超时 (相对时间) 或被信号打断.
+//            返回 0 表示被唤醒 (可能是虚假唤醒), 否则返回 errno (EAGAIN/ETIMEDOUT/EINTR)
+// futexWake: 最多唤醒 count 个等待在 addr 上的线程, 返回被唤醒的线程数
+//
+// isPrivate 为 true 时带 FUTEX_PRIVATE_FLAG, 只在本进程内匹配, 内核处理更快;
+// 放在多个进程共享的内存中的 futex 必须传 false
+int futexWait(const volatile uint32_t *addr, uint32_t expected,
+              const struct timespec *timeout = NULL, bool isPrivate = true);
+int futexWake(const volatile uint32_t *addr, int count, bool isPrivate = true);
+
+} // namespace detail
+
+__POSIX_THREAD_END
+#endif // !__FUTEX_H__
@@ -0,0 +1,99 @@
+#include "LatencyHistogram.h"
+#include <limits>
+#include <string.h>
+
+__POSIX_THREAD_BEGIN
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::reset()
+{
+  ::memset(counts_, 0, sizeof counts_);
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<int64_t>::max();
+  max_ = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+  for (int i = 0; i < kBucketCount; ++i)
+  {
+    counts_[i] += detail::atomicLoad(&other.counts_[i], __ATOMIC_RELAXED);
+  }
+  count_ += detail::atomicLoad(&other.count_, __ATOMIC_RELAXED);
+  sum_ += detail::atomicLoad(&other.sum_, __ATOMIC_RELAXED);
+
+  int64_t otherMin = detail::atomicLoad(&other.min_, __ATOMIC_RELAXED);
+  int64_t otherMax = detail::atomicLoad(&other.max_, __ATOMIC_RELAXED);
+  if (otherMin < min_)
+  {
+    min_ = otherMin;
+  }
+  if (otherMax > max_)
+  {
+    max_ = otherMax;
+  }
+}
+
+double LatencyHistogram::mean() const
+{
+  return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  if (p < 0.0)
+  {
+    p = 0.0;
+  }
+  if (p > 100.0)
+  {
+    p = 100.0;
+  }
+
+  // 快照期间写者可能还在写, 各桶之和与 count_ 不一定相等, 以桶的实际累计为准
+  uint64_t total = 0;
+  for (int i = 0; i < kBucketCount; ++i)
+  {
+    total += counts_[i];
+  }
+  uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+  if (target == 0)
+  {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; ++i)
+  {
+    seen += counts_[i];
+    if (seen >= target)
+    {
+      int64_t bound = bucketUpperBound(i);
+      return bound < max_ ? bound : max_;
+    }
+  }
+  return max_;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index)
+{
+  if (index < kSubBucketCount)
+  {
+    return index;
+  }
+  int shift = index / kSubBucketCount - 1;
+  int64_t sub = index % kSubBucketCount + kSubBucketCount;
+  int64_t low = sub << shift;
+  return low + ((static_cast<int64_t>(1) << shift) - 1);
+}
+
+__POSIX_THREAD_END
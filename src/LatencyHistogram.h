@@ -0,0 +1,82 @@
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include "Atomic.h"
+#include <stdint.h>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * HDR 风格的对数-线性直方图, 用来记录延迟(单位由使用者决定, 库内一律用纳秒)。
+ *
+ *  每个 2 的幂区间再等分成 kSubBucketCount 个子桶, 相对误差不超过 1/kSubBucketCount (约 6%),
+ *  覆盖 [0, 2^63) 的全部取值, 桶下标只需要一次 clz 计算, 不需要浮点运算。
+ *
+ *  record() 只允许一个线程调用(单写者), 内部使用 relaxed 读写, 没有 lock 前缀, 几纳秒即可完成；
+ *  其他线程可以随时用 merge() 把它合并到自己的副本中, 不需要停下写者, 读到的是一个近似一致的快照。
+ */
+class LatencyHistogram
+{
+public:
+  static const int kSubBucketBits = 4;
+  static const int kSubBucketCount = 1 << kSubBucketBits;
+  static const int kBucketCount = (64 - kSubBucketBits) * kSubBucketCount;
+
+  LatencyHistogram();
+
+  void record(int64_t value)
+  {
+    if (unlikely(value < 0))
+    {
+      value = 0;
+    }
+    detail::relaxedAdd(&counts_[bucketIndex(value)], static_cast<uint64_t>(1));
+    detail::relaxedAdd(&count_, static_cast<uint64_t>(1));
+    detail::relaxedAdd(&sum_, static_cast<uint64_t>(value));
+    if (value > detail::atomicLoad(&max_, __ATOMIC_RELAXED))
+    {
+      detail::atomicStore(&max_, value, __ATOMIC_RELAXED);
+    }
+    if (value < detail::atomicLoad(&min_, __ATOMIC_RELAXED))
+    {
+      detail::atomicStore(&min_, value, __ATOMIC_RELAXED);
+    }
+  }
+
+  // 把 other 累加到当前对象, other 可以正在被它的写者线程 record()
+  void merge(const LatencyHistogram &other);
+  void reset();
+
+  uint64_t count() const { return count_; }
+  int64_t min() const { return count_ == 0 ? 0 : min_; }
+  int64_t max() const { return max_; }
+  double mean() const;
+
+  // p 取值 [0, 100], 返回落在该分位的桶的上界(不超过 max())
+  int64_t percentile(double p) const;
+
+  static int bucketIndex(int64_t value)
+  {
+    uint64_t v = static_cast<uint64_t>(value);
+    if (v < static_cast<uint64_t>(kSubBucketCount))
+    {
+      return static_cast<int>(v);
+    }
+    int exponent = 63 - __builtin_clzll(v);
+    int shift = exponent - kSubBucketBits;
+    int sub = static_cast<int>(v >> shift) - kSubBucketCount;
+    return (shift + 1) * kSubBucketCount + sub;
+  }
+
+  static int64_t bucketUpperBound(int index);
+
+private:
+  uint64_t counts_[kBucketCount];
+  uint64_t count_;
+  uint64_t sum_;
+  int64_t min_;
+  int64_t max_;
+};
+
+__POSIX_THREAD_END
+#endif // !__LATENCY_HISTOGRAM_H__
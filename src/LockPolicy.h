@@ -0,0 +1,261 @@
+#ifndef __LOCK_POLICY_H__
+#define __LOCK_POLICY_H__
+
+#include "posix_port.h"
+#include "Atomic.h"
+#include "Futex.h"
+#include "SpinWait.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * 锁策略: 同步类和容器把锁的类型作为模板参数 (参考 ACE 的 ACE_Null_Mutex / Loki 的 ThreadingModel),
+ * 同一份代码在服务里用真正的锁, 在单线程的批处理工具里用 NullMutex, 不必为用不到的 pthread 加锁付费。
+ *
+ *  策略只需要提供 lock()/unlock(), 因此都可以交给 MutexLockGuard<T> 使用:
+ *   NullMutex : 空操作, 内联之后什么代码也不生成. 只能在单线程中使用。
+ *   SpinLock  : test-and-test-and-set 自旋锁, 4 字节, 临界区只有几条指令且竞争很少时使用.
+ *               等待时按 SpinWait 退避, 持锁线程被切换出去时等待者会 yield/睡眠, 但唤醒不及时,
+ *               线程数多于 CPU 数时不要用。
+ *   FastMutex : 基于 futex 的互斥锁 (Drepper, "Futexes Are Tricky" 中的 mutex3), 4 字节,
+ *               无竞争时加锁/解锁各一次原子操作, 不进入内核; 有竞争时睡眠。
+ *   MutexLock : pthread_mutex_t, 记录持有者, 可以配合 Condition 和 IsLockedByThisThread() 使用。
+ *
+ *  选哪一个由 posix_thread_bench.exx 的测量决定, 不要凭空猜测。
+ *  与锁配套的条件变量由 LockTraits<Mutex>::Condition 给出, 构造函数同样接受锁的引用。
+ */
+
+// 单线程用的空锁
+class NullMutex
+{
+public:
+  NullMutex() {}
+
+  NullMutex(const NullMutex &mutex) = delete;
+  NullMutex &operator=(const NullMutex &mutex) = delete;
+
+  void lock() {}
+  void unlock() {}
+  bool tryLock() { return true; }
+};
+
+class SpinLock
+{
+public:
+  SpinLock()
+      : locked_(0)
+  {
+  }
+
+  SpinLock(const SpinLock &lock) = delete;
+  SpinLock &operator=(const SpinLock &lock) = delete;
+
+  void lock()
+  {
+    SpinWait spin;
+    while (detail::atomicExchange(&locked_, 1u, __ATOMIC_ACQUIRE) != 0)
+    {
+      // 只读等待, 锁被释放之前不反复抢占缓存行
+      while (detail::atomicLoad(&locked_, __ATOMIC_RELAXED) != 0)
+      {
+        spin.spinOnce();
+      }
+    }
+  }
+
+  bool tryLock()
+  {
+    return detail::atomicLoad(&locked_, __ATOMIC_RELAXED) == 0 &&
+           detail::atomicExchange(&locked_, 1u, __ATOMIC_ACQUIRE) == 0;
+  }
+
+  void unlock()
+  {
+    detail::atomicStore(&locked_, 0u, __ATOMIC_RELEASE);
+  }
+
+private:
+  uint32_t locked_;
+};
+
+class FastMutex
+{
+public:
+  FastMutex()
+      : state_(kUnlocked)
+  {
+  }
+
+  FastMutex(const FastMutex &mutex) = delete;
+  FastMutex &operator=(const FastMutex &mutex) = delete;
+
+  void lock()
+  {
+    uint32_t state = kUnlocked;
+    if (likely(detail::atomicCompareExchange(&state_, state, static_cast<uint32_t>(kLocked),
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)))
+    {
+      return;
+    }
+    // 拿不到锁时把状态改为 kContended 再睡眠, 解锁者看到 kContended 才调用 futexWake
+    if (state != kContended)
+    {
+      state = detail::atomicExchange(&state_, static_cast<uint32_t>(kContended), __ATOMIC_ACQUIRE);
+    }
+    while (state != kUnlocked)
+    {
+      detail::futexWait(&state_, kContended);
+      state = detail::atomicExchange(&state_, static_cast<uint32_t>(kContended), __ATOMIC_ACQUIRE);
+    }
+  }
+
+  bool tryLock()
+  {
+    uint32_t state = kUnlocked;
+    return detail::atomicCompareExchange(&state_, state, static_cast<uint32_t>(kLocked),
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+  }
+
+  void unlock()
+  {
+    if (unlikely(detail::atomicExchange(&state_, static_cast<uint32_t>(kUnlocked), __ATOMIC_RELEASE) == kContended))
+    {
+      detail::futexWake(&state_, 1);
+    }
+  }
+
+private:
+  enum State
+  {
+    kUnlocked = 0,
+    kLocked = 1,    // 已加锁, 没有等待者
+    kContended = 2, // 已加锁, 可能有等待者
+  };
+
+  uint32_t state_;
+};
+
+/**
+ * NullMutex 配套的条件变量: 单线程中没有别人能改变条件, Wait() 会永远阻塞, 因此直接报错退出;
+ * WaitForSeconds() 睡够时间后返回超时。
+ */
+class NullCondition
+{
+public:
+  NullCondition(const NullCondition &cond) = delete;
+  NullCondition &operator=(const NullCondition &cond) = delete;
+
+  explicit NullCondition(NullMutex &) {}
+
+  void Wait()
+  {
+    fprintf(stderr, "File:%s, Line:%d, Function:%s, Wait() on NullCondition would block forever\n",
+            __FILE__, __LINE__, __FUNCTION__);
+    abort();
+  }
+
+  bool WaitForSeconds(double seconds)
+  {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(seconds);
+    ts.tv_nsec = static_cast<long>((seconds - static_cast<double>(ts.tv_sec)) * 1e9);
+    ::nanosleep(&ts, NULL);
+    return true;
+  }
+
+  void Signal() {}
+  void SignalAll() {}
+};
+
+/**
+ * SpinLock/FastMutex 配套的条件变量: 一个 32 位序号加 futex。
+ *  Wait() 在持锁时读出序号, 解锁后在这个序号上睡眠; Signal() 先递增序号再唤醒,
+ *  所以在读序号之后发生的 Signal() 都会让 futexWait 立即返回, 不会丢失唤醒。
+ *  与 Condition 一样可能虚假唤醒, 调用者需要在 while 循环中检查条件。
+ */
+template <typename Mutex>
+class FutexCondition
+{
+public:
+  FutexCondition(const FutexCondition &cond) = delete;
+  FutexCondition &operator=(const FutexCondition &cond) = delete;
+
+  explicit FutexCondition(Mutex &mutex)
+      : mutex_(mutex),
+        seq_(0)
+  {
+  }
+
+  void Wait()
+  {
+    uint32_t seq = detail::atomicLoad(&seq_, __ATOMIC_RELAXED);
+    mutex_.unlock();
+    detail::futexWait(&seq_, seq);
+    mutex_.lock();
+  }
+
+  // 最多等待 seconds 秒, 超时返回 true
+  bool WaitForSeconds(double seconds)
+  {
+    const int64_t kNanoSecondsPerSecond = 1000 * 1000 * 1000;
+    int64_t nanoseconds = static_cast<int64_t>(seconds * kNanoSecondsPerSecond);
+    struct timespec timeout;
+    timeout.tv_sec = static_cast<time_t>(nanoseconds / kNanoSecondsPerSecond);
+    timeout.tv_nsec = static_cast<long>(nanoseconds % kNanoSecondsPerSecond);
+
+    uint32_t seq = detail::atomicLoad(&seq_, __ATOMIC_RELAXED);
+    mutex_.unlock();
+    int result = detail::futexWait(&seq_, seq, &timeout);
+    mutex_.lock();
+    return result == ETIMEDOUT;
+  }
+
+  void Signal()
+  {
+    detail::atomicFetchAdd(&seq_, 1u, __ATOMIC_RELEASE);
+    detail::futexWake(&seq_, 1);
+  }
+
+  void SignalAll()
+  {
+    detail::atomicFetchAdd(&seq_, 1u, __ATOMIC_RELEASE);
+    detail::futexWake(&seq_, INT_MAX);
+  }
+
+private:
+  Mutex &mutex_;
+  uint32_t seq_;
+};
+
+/**
+ * LockTraits<Mutex>::Condition    : 与锁配套的条件变量
+ * LockTraits<Mutex>::kThreadSafe  : 能否在多个线程之间共享, 容器据此决定是否需要 seqlock 等并发读机制
+ */
+template <typename Mutex>
+struct LockTraits
+{
+  typedef FutexCondition<Mutex> Condition;
+  static const bool kThreadSafe = true;
+};
+
+template <>
+struct LockTraits<MutexLock>
+{
+  typedef PosixThread::Condition Condition;
+  static const bool kThreadSafe = true;
+};
+
+template <>
+struct LockTraits<NullMutex>
+{
+  typedef NullCondition Condition;
+  static const bool kThreadSafe = false;
+};
+
+__POSIX_THREAD_END
+#endif // !__LOCK_POLICY_H__
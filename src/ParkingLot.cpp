@@ -0,0 +1,176 @@
+#include "ParkingLot.h"
+#include "Timestamp.h"
+#include "posix_port.h"
+#include <limits.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// 等待节点放在等待线程的栈上, 使用所在桶的锁
+struct ParkNode
+{
+  const void *addr;
+  Condition cond;
+  bool unparked;
+  ParkNode *prev;
+  ParkNode *next;
+
+  ParkNode(const void *address, MutexLock &mutex)
+      : addr(address),
+        cond(mutex),
+        unparked(false),
+        prev(NULL),
+        next(NULL)
+  {
+  }
+};
+
+struct ParkBucket
+{
+  MutexLock mutex;
+  ParkNode *head;
+  ParkNode *tail;
+  uint64_t waiters; // 锁内修改, unpark 的快速路径在锁外读
+  char pad_[POSIX_CACHELINE_SIZE];
+
+  ParkBucket()
+      : head(NULL),
+        tail(NULL),
+        waiters(0)
+  {
+  }
+
+  void append(ParkNode *node)
+  {
+    node->prev = tail;
+    node->next = NULL;
+    if (tail)
+    {
+      tail->next = node;
+    }
+    else
+    {
+      head = node;
+    }
+    tail = node;
+  }
+
+  void remove(ParkNode *node)
+  {
+    if (node->prev)
+    {
+      node->prev->next = node->next;
+    }
+    else
+    {
+      head = node->next;
+    }
+    if (node->next)
+    {
+      node->next->prev = node->prev;
+    }
+    else
+    {
+      tail = node->prev;
+    }
+    node->prev = node->next = NULL;
+  }
+};
+
+static const size_t kParkBucketCount = 256;
+
+// 函数内的静态对象在第一次使用时构造 (C++11 保证线程安全), 避免静态初始化顺序问题
+static ParkBucket &bucketFor(const void *addr)
+{
+  static ParkBucket buckets[kParkBucketCount];
+  uintptr_t key = reinterpret_cast<uintptr_t>(addr);
+  key ^= key >> 17;
+  key *= static_cast<uintptr_t>(0x9E3779B97F4A7C15ULL);
+  return buckets[(key >> 24) & (kParkBucketCount - 1)];
+}
+
+} // namespace detail
+
+ParkingLot::ParkResult ParkingLot::parkImpl(const void *addr, bool (*validate)(void *), void *context,
+                                            int64_t timeoutUsec)
+{
+  detail::ParkBucket &bucket = detail::bucketFor(addr);
+  MutexLockGuard<MutexLock> lock(bucket.mutex);
+
+  // 先登记等待者再检查条件, 与 unpark 快速路径中的 "先修改条件再读等待者个数" 配对
+  detail::atomicFetchAdd(&bucket.waiters, static_cast<uint64_t>(1));
+  if (!validate(context))
+  {
+    detail::atomicFetchAdd(&bucket.waiters, static_cast<uint64_t>(-1));
+    return kSkipped;
+  }
+
+  detail::ParkNode node(addr, bucket.mutex);
+  bucket.append(&node);
+  // 截止时间只算一次, 虚假唤醒之后只等剩下的时间
+  Timestamp deadline = timeoutUsec > 0 ? addNanos(Timestamp::now(), timeoutUsec * 1000) : Timestamp::invalid();
+  bool timedOut = false;
+  while (!node.unparked && !timedOut)
+  {
+    if (timeoutUsec > 0)
+    {
+      int64_t remaining = nanosBetween(deadline, Timestamp::now());
+      timedOut = remaining <= 0 ||
+                 node.cond.WaitForSeconds(static_cast<double>(remaining) / Timestamp::kNanosPerSecond);
+    }
+    else
+    {
+      node.cond.Wait();
+    }
+  }
+
+  if (node.unparked)
+  {
+    return kUnparked;
+  }
+  bucket.remove(&node);
+  detail::atomicFetchAdd(&bucket.waiters, static_cast<uint64_t>(-1));
+  return kTimedOut;
+}
+
+int ParkingLot::unparkOne(const void *addr)
+{
+  return unpark(addr, 1);
+}
+
+int ParkingLot::unparkAll(const void *addr)
+{
+  return unpark(addr, INT_MAX);
+}
+
+int ParkingLot::unpark(const void *addr, int count)
+{
+  detail::ParkBucket &bucket = detail::bucketFor(addr);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (detail::atomicLoad(&bucket.waiters, __ATOMIC_RELAXED) == 0)
+  {
+    return 0;
+  }
+
+  int woken = 0;
+  MutexLockGuard<MutexLock> lock(bucket.mutex);
+  detail::ParkNode *node = bucket.head;
+  while (node != NULL && woken < count)
+  {
+    detail::ParkNode *next = node->next;
+    if (node->addr == addr)
+    {
+      bucket.remove(node);
+      detail::atomicFetchAdd(&bucket.waiters, static_cast<uint64_t>(-1));
+      node->unparked = true;
+      node->cond.Signal();
+      ++woken;
+    }
+    node = next;
+  }
+  return woken;
+}
+
+__POSIX_THREAD_END
@@ -0,0 +1,72 @@
+#ifndef __PARKING_LOT_H__
+#define __PARKING_LOT_H__
+
+#include "Atomic.h"
+#include <stdint.h>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * 全局的按地址索引的 parking lot (参考 WebKit WTF::ParkingLot / folly::ParkingLot)
+ *
+ *  任意原子变量都可以拿它的地址来等待, 不需要在对象里放 MutexLock/Condition:
+ *
+ *    while (detail::atomicLoad(&flag_) == 0)
+ *    {
+ *      ParkingLot::park(&flag_, [this]() { return detail::atomicLoad(&flag_) == 0; });
+ *    }
+ *
+ *    detail::atomicStore(&flag_, 1);
+ *    ParkingLot::unparkAll(&flag_);
+ *
+ *  地址被哈希到固定个数的桶, 每个桶有自己的 MutexLock 和等待链表. validate 在桶锁内调用,
+ *  unpark 也要拿同一把锁, 所以 "检查条件" 和 "睡眠" 之间不会丢失唤醒。
+ *  桶里没有等待者时 unparkOne()/unparkAll() 只做一次 load, 不加锁。
+ */
+class ParkingLot
+{
+public:
+  enum ParkResult
+  {
+    kSkipped,  // validate 返回 false, 没有睡眠
+    kUnparked, // 被 unpark 唤醒
+    kTimedOut, // 超时
+  };
+
+  // timeoutUsec <= 0 表示一直等待
+  template <typename Validate>
+  static ParkResult park(const void *addr, Validate validate, int64_t timeoutUsec = 0)
+  {
+    return parkImpl(addr, &invoke<Validate>, &validate, timeoutUsec);
+  }
+
+  // 返回被唤醒的线程数
+  static int unparkOne(const void *addr);
+  static int unparkAll(const void *addr);
+
+  // 等待 *addr 不再等于 expected
+  template <typename T>
+  static void waitWhileEqual(const volatile T *addr, T expected)
+  {
+    while (detail::atomicLoad(addr, __ATOMIC_ACQUIRE) == expected)
+    {
+      park(const_cast<const T *>(addr), [addr, expected]() {
+        return detail::atomicLoad(addr, __ATOMIC_ACQUIRE) == expected;
+      });
+    }
+  }
+
+private:
+  template <typename Validate>
+  static bool invoke(void *validate)
+  {
+    return (*static_cast<Validate *>(validate))();
+  }
+
+  static ParkResult parkImpl(const void *addr, bool (*validate)(void *), void *context,
+                             int64_t timeoutUsec);
+  static int unpark(const void *addr, int count);
+};
+
+__POSIX_THREAD_END
+#endif // !__PARKING_LOT_H__
@@ -0,0 +1,346 @@
+#include "Pipeline.h"
+#include "Atomic.h"
+#include "FastClock.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace
+{
+
+const char *modeName(int mode)
+{
+  switch (mode)
+  {
+  case PipelineBase::kSerialInOrder:
+    return "serial-in-order";
+  case PipelineBase::kSerialOutOfOrder:
+    return "serial-out-of-order";
+  default:
+    return "parallel";
+  }
+}
+
+} // namespace
+
+std::string PipelineStats::report() const
+{
+  std::string result;
+  char line[256];
+  snprintf(line, sizeof line, "threads %d, tokens %zu (max in flight %zu), wall %.3f ms, workers idle %.1f%%\n",
+           threads, tokens, maxInFlight, wallNs / 1e6,
+           wallNs > 0 && threads > 0 ? 100.0 * idleNs / (static_cast<double>(wallNs) * threads) : 0.0);
+  result += line;
+  for (size_t i = 0; i < stages.size(); ++i)
+  {
+    const Stage &stage = stages[i];
+    int width = stage.mode == PipelineBase::kParallel ? threads : 1;
+    double busy = wallNs > 0 && width > 0 ? 100.0 * stage.busyNs / (static_cast<double>(wallNs) * width) : 0.0;
+    snprintf(line, sizeof line, "  %-12s %-19s %10llu items %12.0f items/s  busy %5.1f%%  idle %5.1f%%  wait %.3f ms\n",
+             stage.name.c_str(), modeName(stage.mode), static_cast<unsigned long long>(stage.items),
+             wallNs > 0 ? stage.items * 1e9 / wallNs : 0.0, busy, busy < 100.0 ? 100.0 - busy : 0.0,
+             stage.waitNs / 1e6);
+    result += line;
+  }
+  return result;
+}
+
+PipelineBase::PipelineBase(const std::string &name)
+    : name_(name),
+      mutex_(),
+      cond_(mutex_),
+      nextSeq_(0),
+      inFlight_(0),
+      maxInFlight_(0),
+      inputDone_(false),
+      running_(false),
+      threads_(0),
+      tokens_(0),
+      startNs_(0),
+      endNs_(0),
+      idleNs_(0)
+{
+  // stages_[0] 是 source, 调度时与其他串行有序阶段一样处理
+  addStage("source", kSerialInOrder, StageFunc());
+}
+
+PipelineBase::~PipelineBase()
+{
+  assert(!running_);
+}
+
+void PipelineBase::setSource(const SourceFunc &source)
+{
+  assert(!running_);
+  source_ = source;
+}
+
+void PipelineBase::addStage(const std::string &name, Mode mode, const StageFunc &func)
+{
+  assert(!running_);
+  std::unique_ptr<Stage> stage(new Stage);
+  stage->name = name;
+  stage->mode = mode;
+  stage->func = func;
+  stage->busy = false;
+  stage->nextSeq = 0;
+  stage->items = 0;
+  stage->busyNs = 0;
+  stage->waitNs = 0;
+  stages_.push_back(std::move(stage));
+}
+
+void PipelineBase::run(int numThreads, size_t maxTokens)
+{
+  assert(numThreads > 0 && maxTokens > 0);
+  if (!source_)
+  {
+    fprintf(stderr, "File:%s, Line:%d, Function:%s, pipeline %s has no source\n",
+            __FILE__, __LINE__, __FUNCTION__, name_.c_str());
+    abort();
+  }
+  reserveTokens(maxTokens);
+
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    assert(!running_);
+    freeTokens_.clear();
+    for (size_t i = maxTokens; i > 0; --i)
+    {
+      freeTokens_.push_back(i - 1);
+    }
+    ready_.clear();
+    seq_.assign(maxTokens, 0);
+    arrivedNs_.assign(maxTokens, 0);
+    nextSeq_ = 0;
+    inFlight_ = 0;
+    maxInFlight_ = 0;
+    inputDone_ = false;
+    running_ = true;
+    threads_ = numThreads;
+    tokens_ = maxTokens;
+    idleNs_ = 0;
+    for (size_t i = 0; i < stages_.size(); ++i)
+    {
+      Stage *stage = stages_[i].get();
+      stage->busy = false;
+      stage->nextSeq = 0;
+      detail::atomicStore(&stage->items, static_cast<uint64_t>(0), __ATOMIC_RELAXED);
+      detail::atomicStore(&stage->busyNs, static_cast<int64_t>(0), __ATOMIC_RELAXED);
+      detail::atomicStore(&stage->waitNs, static_cast<int64_t>(0), __ATOMIC_RELAXED);
+    }
+    startNs_ = FastClock::nowNanos();
+  }
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < numThreads; ++i)
+  {
+    char id[32];
+    snprintf(id, sizeof id, "%d", i + 1);
+    threads.emplace_back(new Thread(std::bind(&PipelineBase::runInThread, this), name_ + id));
+    threads.back()->start();
+  }
+  for (int i = 0; i < numThreads; ++i)
+  {
+    threads[i]->join();
+  }
+
+  MutexLockGuard<MutexLock> lock(mutex_);
+  endNs_ = FastClock::nowNanos();
+  running_ = false;
+}
+
+PipelineStats PipelineBase::stats() const
+{
+  PipelineStats result;
+  MutexLockGuard<MutexLock> lock(mutex_);
+  result.threads = threads_;
+  result.tokens = tokens_;
+  result.maxInFlight = maxInFlight_;
+  result.wallNs = (running_ ? FastClock::nowNanos() : endNs_) - startNs_;
+  result.idleNs = idleNs_;
+  for (size_t i = 0; i < stages_.size(); ++i)
+  {
+    const Stage *stage = stages_[i].get();
+    PipelineStats::Stage s;
+    s.name = stage->name;
+    s.mode = stage->mode;
+    s.items = detail::atomicLoad(&stage->items, __ATOMIC_RELAXED);
+    s.busyNs = detail::atomicLoad(&stage->busyNs, __ATOMIC_RELAXED);
+    s.waitNs = detail::atomicLoad(&stage->waitNs, __ATOMIC_RELAXED);
+    result.stages.push_back(s);
+  }
+  return result;
+}
+
+void PipelineBase::runInThread()
+{
+  Ready work;
+  while (take(&work))
+  {
+    process(work.token, work.stage);
+  }
+}
+
+// 优先继续执行已经在途的数据项 (就绪队列), 其次从 source 取新的数据项, 都没有就睡眠
+bool PipelineBase::take(Ready *out)
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  while (true)
+  {
+    if (!ready_.empty())
+    {
+      *out = ready_.front();
+      ready_.pop_front();
+      return true;
+    }
+    Stage *source = stages_[0].get();
+    if (!inputDone_ && !source->busy && !freeTokens_.empty())
+    {
+      source->busy = true;
+      out->token = freeTokens_.back();
+      out->stage = 0;
+      freeTokens_.pop_back();
+      if (++inFlight_ > maxInFlight_)
+      {
+        maxInFlight_ = inFlight_;
+      }
+      return true;
+    }
+    if (inputDone_ && inFlight_ == 0)
+    {
+      return false;
+    }
+    int64_t idleStart = FastClock::nowNanos();
+    cond_.Wait();
+    idleNs_ += FastClock::nowNanos() - idleStart;
+  }
+}
+
+// 当前线程带着 token 从 first 阶段一直往下执行, 直到走完或者被挂在某个串行阶段的入口
+void PipelineBase::process(size_t token, size_t first)
+{
+  for (size_t i = first; i < stages_.size(); ++i)
+  {
+    Stage *stage = stages_[i].get();
+    if (i != first && stage->mode != kParallel && !enter(stage, token))
+    {
+      return;
+    }
+
+    int64_t start = FastClock::nowNanos();
+    if (i == 0)
+    {
+      bool produced = source_(token);
+      detail::relaxedAdd(&stage->busyNs, FastClock::nowNanos() - start);
+      if (!produced)
+      {
+        finish(token, false);
+        return;
+      }
+      seq_[token] = nextSeq_++;
+    }
+    else
+    {
+      stage->func(token);
+      // 并行阶段的计数器有多个写者, 不能用 relaxedAdd
+      detail::atomicFetchAdd(&stage->busyNs, FastClock::nowNanos() - start, __ATOMIC_RELAXED);
+    }
+    detail::atomicFetchAdd(&stage->items, static_cast<uint64_t>(1), __ATOMIC_RELAXED);
+
+    if (stage->mode != kParallel)
+    {
+      leave(stage, i);
+    }
+  }
+  finish(token, true);
+}
+
+// 尝试占用串行阶段, 失败时把 token 挂在阶段入口, 由占用者 leave() 时放入就绪队列
+bool PipelineBase::enter(Stage *stage, size_t token)
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (!stage->busy && (stage->mode != kSerialInOrder || seq_[token] == stage->nextSeq))
+  {
+    stage->busy = true;
+    return true;
+  }
+  arrivedNs_[token] = FastClock::nowNanos();
+  if (stage->mode == kSerialInOrder)
+  {
+    stage->ordered[seq_[token]] = token;
+  }
+  else
+  {
+    stage->arrived.push_back(token);
+  }
+  return false;
+}
+
+void PipelineBase::leave(Stage *stage, size_t index)
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  stage->busy = false;
+  size_t next = 0;
+  bool found = false;
+  if (stage->mode == kSerialInOrder)
+  {
+    ++stage->nextSeq;
+    std::map<uint64_t, size_t>::iterator it = stage->ordered.begin();
+    if (it != stage->ordered.end() && it->first == stage->nextSeq)
+    {
+      next = it->second;
+      stage->ordered.erase(it);
+      found = true;
+    }
+  }
+  else if (!stage->arrived.empty())
+  {
+    next = stage->arrived.front();
+    stage->arrived.pop_front();
+    found = true;
+  }
+
+  if (found)
+  {
+    stage->busy = true;
+    detail::relaxedAdd(&stage->waitNs, FastClock::nowNanos() - arrivedNs_[next]);
+    Ready ready;
+    ready.token = next;
+    ready.stage = index;
+    ready_.push_back(ready);
+    cond_.Signal();
+  }
+  else if (index == 0 && !inputDone_ && !freeTokens_.empty())
+  {
+    // source 空出来了, 让睡眠的线程去取下一个数据项
+    cond_.Signal();
+  }
+}
+
+void PipelineBase::finish(size_t token, bool produced)
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (!produced)
+  {
+    inputDone_ = true;
+    stages_[0]->busy = false;
+  }
+  freeTokens_.push_back(token);
+  --inFlight_;
+  if (inputDone_)
+  {
+    if (inFlight_ == 0)
+    {
+      cond_.SignalAll();
+    }
+  }
+  else if (!stages_[0]->busy)
+  {
+    cond_.Signal();
+  }
+}
+
+__POSIX_THREAD_END
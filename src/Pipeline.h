@@ -0,0 +1,189 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include "posix_thread.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * 流水线运行时统计的快照, 由 Pipeline::stats() 生成, 运行中也可以调用。所有时间单位都是纳秒。
+ */
+struct PipelineStats
+{
+  struct Stage
+  {
+    std::string name;
+    int mode;       // PipelineBase::Mode
+    uint64_t items; // 处理过的数据项个数
+    int64_t busyNs; // 执行阶段函数的时间 (并行阶段为所有线程之和)
+    int64_t waitNs; // 数据项因为串行阶段被占用 (或者还没轮到它的序号) 而在阶段入口排队的时间
+  };
+
+  int threads;
+  size_t tokens;       // 最大在途数据项个数
+  size_t maxInFlight;  // 实际达到的最大在途个数
+  int64_t wallNs;      // run() 开始到结束 (或者到现在) 的时间
+  int64_t idleNs;      // 工作线程没有可做的事情而睡眠的时间之和
+  std::vector<Stage> stages; // stages[0] 是 source
+
+  // 每个阶段一行: 吞吐量, 忙碌比例 (串行阶段按 1 个线程, 并行阶段按 threads 个线程计算), 排队时间
+  std::string report() const;
+};
+
+/**
+ * 流水线的调度部分, 与数据项的类型无关, 数据项用下标 (token) 表示。使用者通过 Pipeline<T> 使用。
+ *
+ *  调度方式参考 TBB parallel_pipeline:
+ *  - 一个工作线程从 source 取得一个数据项之后, 带着它依次执行后面的各个阶段, 数据项一直留在同一个线程的缓存中,
+ *    阶段之间没有队列, 也没有线程切换。
+ *  - 串行阶段同一时刻只有一个数据项在执行。数据项到达时阶段被占用 (有序阶段还要求轮到它的序号),
+ *    就把它挂在阶段的入口, 当前线程去做别的事情 (通常是从 source 取下一个数据项);
+ *    占用阶段的线程执行完之后把下一个可以执行的数据项放入就绪队列, 由空闲的线程接着往下执行。
+ *  - 在途的数据项不超过 maxTokens 个, 数据项对象预先分配, 走完最后一个阶段后回收给 source 复用,
+ *    所以内存有上界, 数据项中的缓冲区 (std::string, std::vector 等) 也可以复用已经分配的容量。
+ *  - source 是串行有序的, 数据项的序号就是 source 产生它的顺序, 所有有序阶段都按这个顺序执行。
+ *
+ *  调度状态由一把 MutexLock 保护, 只在数据项进出串行阶段和取新数据项时加锁, 阶段函数在锁外执行。
+ */
+class PipelineBase
+{
+public:
+  enum Mode
+  {
+    kSerialInOrder = 0,    // 串行, 按 source 产生的顺序
+    kSerialOutOfOrder = 1, // 串行, 按到达的顺序
+    kParallel = 2,         // 多个数据项可以同时执行
+  };
+
+  PipelineBase(const PipelineBase &pipeline) = delete;
+  PipelineBase &operator=(const PipelineBase &pipeline) = delete;
+
+  // 用 numThreads 个线程运行流水线, 直到 source 返回 false 并且所有数据项都走完, 返回之后可以再次 run()
+  void run(int numThreads, size_t maxTokens);
+
+  const std::string &name() const { return name_; }
+  PipelineStats stats() const;
+
+protected:
+  using SourceFunc = std::function<bool(size_t token)>;
+  using StageFunc = std::function<void(size_t token)>;
+
+  explicit PipelineBase(const std::string &name);
+  virtual ~PipelineBase();
+
+  void setSource(const SourceFunc &source);
+  void addStage(const std::string &name, Mode mode, const StageFunc &func);
+  // run() 开始之前调用, 保证至少有 tokens 个数据项对象
+  virtual void reserveTokens(size_t tokens) = 0;
+
+private:
+  struct Stage
+  {
+    std::string name;
+    Mode mode;
+    StageFunc func;
+    // 以下由 mutex_ 保护
+    bool busy;
+    uint64_t nextSeq;                   // 有序阶段下一个应该执行的序号
+    std::map<uint64_t, size_t> ordered; // 有序阶段入口: 序号 -> token
+    std::deque<size_t> arrived;         // 无序阶段入口
+    // 统计, 原子累加
+    char pad_[POSIX_CACHELINE_SIZE];
+    uint64_t items;
+    int64_t busyNs;
+    int64_t waitNs;
+  };
+
+  struct Ready
+  {
+    size_t token;
+    size_t stage; // 从这个阶段开始执行, 串行阶段已经被占用
+  };
+
+  void runInThread();
+  bool take(Ready *out);
+  void process(size_t token, size_t first);
+  bool enter(Stage *stage, size_t token);
+  void leave(Stage *stage, size_t index);
+  void finish(size_t token, bool produced);
+
+private:
+  std::string name_;
+  SourceFunc source_;
+  std::vector<std::unique_ptr<Stage>> stages_;
+
+  mutable MutexLock mutex_;
+  Condition cond_;
+  std::vector<size_t> freeTokens_;
+  std::deque<Ready> ready_;
+  std::vector<uint64_t> seq_;       // token 的序号
+  std::vector<int64_t> arrivedNs_; // token 在阶段入口开始排队的时间
+  uint64_t nextSeq_;              // source 产生的下一个序号, 只由占用 source 的线程修改
+  size_t inFlight_;
+  size_t maxInFlight_;
+  bool inputDone_;
+  bool running_;
+
+  int threads_;
+  size_t tokens_;
+  int64_t startNs_;
+  int64_t endNs_;
+  int64_t idleNs_;
+};
+
+/**
+ * Pipeline<T>: 线性流水线 (例如 读取 -> 解析 -> 转换 -> 压缩 -> 写出), 替代 "每个阶段一个 Thread + 阶段之间的队列"。
+ *
+ *  Pipeline<Chunk> pipeline("etl");
+ *  pipeline.source([&](Chunk &chunk) { return readNext(&chunk); })
+ *          .stage("parse", Pipeline<Chunk>::kParallel, parse)
+ *          .stage("write", Pipeline<Chunk>::kSerialInOrder, write);
+ *  pipeline.run(4, 16);
+ *
+ *  source 填充一个 (回收来的) T, 没有更多输入时返回 false; 阶段函数原地修改 T。
+ *  T 需要可默认构造, 对象在多次 run() 之间保留, source 负责覆盖上一次留下的内容。
+ */
+template <typename T>
+class Pipeline : public PipelineBase
+{
+public:
+  explicit Pipeline(const std::string &name = std::string("Pipeline"))
+      : PipelineBase(name)
+  {
+  }
+
+  // 必须在 run() 之前设置
+  Pipeline &source(const std::function<bool(T &)> &func)
+  {
+    setSource([this, func](size_t token) { return func(items_[token]); });
+    return *this;
+  }
+
+  // 按调用顺序追加阶段, 必须在 run() 之前调用
+  Pipeline &stage(const std::string &name, Mode mode, const std::function<void(T &)> &func)
+  {
+    addStage(name, mode, [this, func](size_t token) { func(items_[token]); });
+    return *this;
+  }
+
+private:
+  void reserveTokens(size_t tokens) override
+  {
+    if (items_.size() < tokens)
+    {
+      items_.resize(tokens);
+    }
+  }
+
+private:
+  std::vector<T> items_;
+};
+
+__POSIX_THREAD_END
+#endif // !__PIPELINE_H__
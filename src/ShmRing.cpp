@@ -0,0 +1,386 @@
+#include "ShmRing.h"
+#include "SpinWait.h"
+#include "Timestamp.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace
+{
+
+// 计算到 deadline 的剩余时间, deadline < 0 表示一直等 (返回 NULL); 已经超时返回 false
+bool remaining(int64_t deadline, struct timespec *ts, struct timespec **timeout)
+{
+  if (deadline < 0)
+  {
+    *timeout = NULL;
+    return true;
+  }
+  int64_t left = deadline - Timestamp::now().micros();
+  if (left <= 0)
+  {
+    return false;
+  }
+  ts->tv_sec = static_cast<time_t>(left / (1000 * 1000));
+  ts->tv_nsec = static_cast<long>(left % (1000 * 1000) * 1000);
+  *timeout = ts;
+  return true;
+}
+
+} // namespace
+
+ShmSegment::ShmSegment(int fd, void *data, size_t size)
+    : fd_(fd),
+      data_(data),
+      size_(size)
+{
+}
+
+ShmSegment::~ShmSegment()
+{
+  ::munmap(data_, size_);
+  ::close(fd_);
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::map(int fd, size_t size)
+{
+  void *data = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+  {
+    int savedErrno = errno;
+    ::close(fd);
+    errno = savedErrno;
+    return std::unique_ptr<ShmSegment>();
+  }
+  return std::unique_ptr<ShmSegment>(new ShmSegment(fd, data, size));
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::createAnonymous(const std::string &name, size_t size)
+{
+  int fd = ::memfd_create(name.c_str(), MFD_CLOEXEC);
+  if (fd < 0)
+  {
+    return std::unique_ptr<ShmSegment>();
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) < 0)
+  {
+    int savedErrno = errno;
+    ::close(fd);
+    errno = savedErrno;
+    return std::unique_ptr<ShmSegment>();
+  }
+  return map(fd, size);
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::openNamed(const std::string &name, size_t size)
+{
+  int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+  {
+    return std::unique_ptr<ShmSegment>();
+  }
+  struct stat st;
+  if (::fstat(fd, &st) < 0)
+  {
+    int savedErrno = errno;
+    ::close(fd);
+    errno = savedErrno;
+    return std::unique_ptr<ShmSegment>();
+  }
+  // 已经存在的段沿用原来的大小, 两个进程同时创建时 ftruncate 到相同大小也没有问题
+  if (st.st_size == 0)
+  {
+    if (::ftruncate(fd, static_cast<off_t>(size)) < 0)
+    {
+      int savedErrno = errno;
+      ::close(fd);
+      errno = savedErrno;
+      return std::unique_ptr<ShmSegment>();
+    }
+  }
+  else
+  {
+    size = static_cast<size_t>(st.st_size);
+  }
+  return map(fd, size);
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::fromFd(int fd)
+{
+  struct stat st;
+  if (::fstat(fd, &st) < 0)
+  {
+    int savedErrno = errno;
+    ::close(fd);
+    errno = savedErrno;
+    return std::unique_ptr<ShmSegment>();
+  }
+  return map(fd, static_cast<size_t>(st.st_size));
+}
+
+bool ShmSegment::unlinkNamed(const std::string &name)
+{
+  return ::shm_unlink(name.c_str()) == 0;
+}
+
+ShmRing::ShmRing(void *memory, size_t bytes, Mode mode)
+    : header_(static_cast<Header *>(memory)),
+      data_(static_cast<char *>(memory) + sizeof(Header)),
+      capacity_(0),
+      mask_(0),
+      maxRecordSize_(0)
+{
+  assert(reinterpret_cast<uintptr_t>(memory) % POSIX_CACHELINE_SIZE == 0);
+  if (bytes < sizeof(Header) + 64)
+  {
+    fprintf(stderr, "File:%s, Line:%d, ShmRing: segment too small (%zu bytes)\n", __FILE__, __LINE__, bytes);
+    abort();
+  }
+  size_t capacity = 64;
+  while (capacity * 2 <= bytes - sizeof(Header))
+  {
+    capacity *= 2;
+  }
+
+  // 第一个把 magic 从 0 改成 kInitializing 的进程负责初始化, 其他进程等待初始化完成
+  uint32_t expected = 0;
+  if (detail::atomicCompareExchange(&header_->magic, expected, kInitializing))
+  {
+    header_->mode = mode;
+    header_->capacity = capacity;
+    detail::atomicStore(&header_->magic, kMagic, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    SpinWait spin;
+    while (detail::atomicLoad(&header_->magic, __ATOMIC_ACQUIRE) != kMagic)
+    {
+      spin.spinOnce();
+    }
+  }
+  if (header_->mode != static_cast<uint32_t>(mode) || header_->capacity > bytes - sizeof(Header))
+  {
+    fprintf(stderr, "File:%s, Line:%d, ShmRing: segment was initialized with mode %u capacity %llu\n",
+            __FILE__, __LINE__, header_->mode, static_cast<unsigned long long>(header_->capacity));
+    abort();
+  }
+  capacity_ = static_cast<size_t>(header_->capacity);
+  mask_ = capacity_ - 1;
+  // 不能太大, 否则回绕时的填充记录会浪费大量空间, 空间不足的情况也会变得频繁
+  maxRecordSize_ = capacity_ / 8 - sizeof(RecordHeader);
+}
+
+void *ShmRing::tryReserve(size_t len)
+{
+  if (len > maxRecordSize_)
+  {
+    return NULL;
+  }
+  const uint64_t recordSize = align(sizeof(RecordHeader) + len);
+  uint64_t tail = detail::atomicLoad(&header_->tail, __ATOMIC_RELAXED);
+  uint64_t padding;
+  for (;;)
+  {
+    uint64_t head = detail::atomicLoad(&header_->head, __ATOMIC_ACQUIRE);
+    uint64_t available = capacity_ - (tail - head);
+    uint64_t toEnd = capacity_ - (tail & mask_);
+    // 放不下时把到末尾的空间变成一条填充记录, 记录从缓冲区开头开始
+    padding = recordSize > toEnd ? toEnd : 0;
+    if (padding + recordSize > available)
+    {
+      return NULL;
+    }
+    if (header_->mode == kSingleProducer)
+    {
+      detail::atomicStore(&header_->tail, tail + padding + recordSize, __ATOMIC_RELAXED);
+      break;
+    }
+    // 失败时 tail 被更新为最新值, 重新计算
+    if (detail::atomicCompareExchange(&header_->tail, tail, tail + padding + recordSize))
+    {
+      break;
+    }
+  }
+
+  if (padding > 0)
+  {
+    RecordHeader *pad = headerAt(tail);
+    pad->size = static_cast<uint32_t>(padding);
+    detail::atomicStore(&pad->type, kRecordPadding, __ATOMIC_RELEASE);
+    tail += padding;
+  }
+  RecordHeader *record = headerAt(tail);
+  record->size = static_cast<uint32_t>(sizeof(RecordHeader) + len);
+  return record + 1;
+}
+
+void *ShmRing::reserve(size_t len, int64_t timeoutUsec)
+{
+  void *data = tryReserve(len);
+  if (data != NULL || len > maxRecordSize_)
+  {
+    return data;
+  }
+
+  // 之前不带通知提交的记录必须让消费者看到, 否则双方会互相等待
+  notifyConsumer();
+  int64_t deadline = timeoutUsec < 0 ? -1 : Timestamp::now().micros() + timeoutUsec;
+  for (;;)
+  {
+    uint32_t signal = detail::atomicLoad(&header_->spaceSignal, __ATOMIC_ACQUIRE);
+    detail::atomicFetchAdd(&header_->producersWaiting, 1u);
+    data = tryReserve(len);
+    if (data != NULL)
+    {
+      detail::atomicFetchAdd(&header_->producersWaiting, static_cast<uint32_t>(-1));
+      return data;
+    }
+    struct timespec ts;
+    struct timespec *timeout;
+    if (!remaining(deadline, &ts, &timeout))
+    {
+      detail::atomicFetchAdd(&header_->producersWaiting, static_cast<uint32_t>(-1));
+      return NULL;
+    }
+    detail::futexWait(&header_->spaceSignal, signal, timeout, false);
+    detail::atomicFetchAdd(&header_->producersWaiting, static_cast<uint32_t>(-1));
+    data = tryReserve(len);
+    if (data != NULL)
+    {
+      return data;
+    }
+  }
+}
+
+void ShmRing::commit(void *data, bool notify)
+{
+  RecordHeader *record = static_cast<RecordHeader *>(data) - 1;
+  detail::atomicStore(&record->type, kRecordData, __ATOMIC_RELEASE);
+  if (notify)
+  {
+    notifyConsumer();
+  }
+}
+
+void ShmRing::notifyConsumer()
+{
+  // 与 waitForData() 中的屏障配对: 要么消费者看到这条记录, 要么这里看到 consumerWaiting
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (unlikely(detail::atomicLoad(&header_->consumerWaiting, __ATOMIC_RELAXED) != 0))
+  {
+    detail::atomicFetchAdd(&header_->dataSignal, 1u);
+    detail::futexWake(&header_->dataSignal, 1, false);
+  }
+}
+
+bool ShmRing::empty() const
+{
+  uint64_t head = detail::atomicLoad(&header_->head, __ATOMIC_RELAXED);
+  return detail::atomicLoad(&headerAt(head)->type, __ATOMIC_ACQUIRE) == 0;
+}
+
+bool ShmRing::waitForData(int64_t timeoutUsec)
+{
+  if (!empty())
+  {
+    return true;
+  }
+
+  int64_t deadline = timeoutUsec < 0 ? -1 : Timestamp::now().micros() + timeoutUsec;
+  for (;;)
+  {
+    uint32_t signal = detail::atomicLoad(&header_->dataSignal, __ATOMIC_ACQUIRE);
+    detail::atomicStore(&header_->consumerWaiting, 1u);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!empty())
+    {
+      detail::atomicStore(&header_->consumerWaiting, 0u);
+      return true;
+    }
+    struct timespec ts;
+    struct timespec *timeout;
+    if (!remaining(deadline, &ts, &timeout))
+    {
+      detail::atomicStore(&header_->consumerWaiting, 0u);
+      return false;
+    }
+    detail::futexWait(&header_->dataSignal, signal, timeout, false);
+    detail::atomicStore(&header_->consumerWaiting, 0u);
+    if (!empty())
+    {
+      return true;
+    }
+  }
+}
+
+// 消费者: 把 [from, to) 清零后推进 head, 必要时唤醒等待空间的生产者
+void ShmRing::release(uint64_t from, uint64_t to)
+{
+  size_t begin = static_cast<size_t>(from & mask_);
+  size_t length = static_cast<size_t>(to - from);
+  if (begin + length <= capacity_)
+  {
+    memset(data_ + begin, 0, length);
+  }
+  else
+  {
+    memset(data_ + begin, 0, capacity_ - begin);
+    memset(data_, 0, length - (capacity_ - begin));
+  }
+  detail::atomicStore(&header_->head, to, __ATOMIC_RELEASE);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (unlikely(detail::atomicLoad(&header_->producersWaiting, __ATOMIC_RELAXED) != 0))
+  {
+    detail::atomicFetchAdd(&header_->spaceSignal, 1u);
+    detail::futexWake(&header_->spaceSignal, INT_MAX, false);
+  }
+}
+
+bool ShmRing::unblock()
+{
+  uint64_t head = detail::atomicLoad(&header_->head, __ATOMIC_RELAXED);
+  uint64_t tail = detail::atomicLoad(&header_->tail, __ATOMIC_ACQUIRE);
+  RecordHeader *record = headerAt(head);
+  if (head == tail || detail::atomicLoad(&record->type, __ATOMIC_ACQUIRE) != 0)
+  {
+    return false;
+  }
+
+  uint64_t size = record->size;
+  if (size == 0)
+  {
+    // 预留之后还没来得及写头部 (数据也还没写, 区域全 0), 或者是消费者清零之后没来得及推进 head:
+    // 向后找到下一条记录的头部, 中间的区域整体跳过。记录不会跨越缓冲区末尾
+    uint64_t end = head + (capacity_ - (head & mask_));
+    if (tail < end)
+    {
+      end = tail;
+    }
+    uint64_t position = head + kAlignment;
+    while (position < end)
+    {
+      RecordHeader *next = headerAt(position);
+      if (next->size != 0 || detail::atomicLoad(&next->type, __ATOMIC_ACQUIRE) != 0)
+      {
+        break;
+      }
+      position += kAlignment;
+    }
+    size = position - head;
+  }
+  record->size = static_cast<uint32_t>(size);
+  detail::atomicStore(&record->type, kRecordPadding, __ATOMIC_RELEASE);
+  return true;
+}
+
+__POSIX_THREAD_END
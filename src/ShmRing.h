@@ -0,0 +1,186 @@
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include "Atomic.h"
+#include "Futex.h"
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * ShmSegment: 用 mmap(MAP_SHARED) 映射的一段共享内存, 析构时 munmap 并关闭 fd。
+ *
+ *  - createAnonymous: memfd_create 创建, 没有名字, 通过 fork 继承或者 SCM_RIGHTS 把 fd 传给对端
+ *  - openNamed: shm_open 打开 (不存在则创建, 文件在 /dev/shm 下), 任何一方进程重启后都可以按名字重新打开
+ *  - fromFd: 接管一个已经打开的 fd (例如收到的 memfd), 大小取文件大小
+ *
+ *  新创建的段内容全为 0. 失败时返回空指针, errno 为失败原因。
+ */
+class ShmSegment
+{
+public:
+  ShmSegment(const ShmSegment &segment) = delete;
+  ShmSegment &operator=(const ShmSegment &segment) = delete;
+
+  static std::unique_ptr<ShmSegment> createAnonymous(const std::string &name, size_t size);
+  static std::unique_ptr<ShmSegment> openNamed(const std::string &name, size_t size);
+  static std::unique_ptr<ShmSegment> fromFd(int fd);
+  static bool unlinkNamed(const std::string &name);
+
+  ~ShmSegment();
+
+  void *data() const { return data_; }
+  size_t size() const { return size_; }
+  int fd() const { return fd_; }
+
+private:
+  ShmSegment(int fd, void *data, size_t size);
+  static std::unique_ptr<ShmSegment> map(int fd, size_t size);
+
+private:
+  int fd_;
+  void *data_;
+  size_t size_;
+};
+
+/**
+ * ShmRing: 放在共享内存中的变长记录环形缓冲区, 用于同一台机器上的进程之间零拷贝传递小记录
+ *  (布局参考 Aeron 的 ring buffer)。
+ *
+ *  生产者 reserve(len) 直接在环形缓冲区中得到一块 len 字节的空间, 原地写好数据后 commit();
+ *  消费者 read(handler) 在原地把记录交给 handler, 不经过额外的拷贝和系统调用。
+ *
+ *  - kSingleProducer: 只有一个生产者, 预留空间时直接写 tail;
+ *    kMultiProducer: 多个生产者 (可以在不同进程中) 用 CAS 抢 tail, 各自独立提交, 都是 lock-free 的。
+ *    只允许一个消费者。
+ *  - 每条记录前有 8 字节的头部, 记录按 8 字节对齐, 不会跨越缓冲区末尾 (放不下时在末尾填一条填充记录)。
+ *    头部的 type 为 0 表示还没有提交, 提交时用 release 写入 type; 消费者用完之后把记录清零再推进 head,
+ *    所以空闲区域总是全 0。
+ *  - 一方空闲时在共享段中的 futex 上睡眠 (不带 FUTEX_PRIVATE_FLAG, 跨进程有效):
+ *    消费者等待数据时置 consumerWaiting, 生产者提交后看到它才调用 futex wake;
+ *    生产者等待空间时增加 producersWaiting, 消费者推进 head 后看到它才调用 futex wake。
+ *    没有人睡眠时两边都不进入内核。
+ *  - head/tail 等状态都在共享段中, 任何一方重启后重新构造 ShmRing 即可从原来的位置继续。
+ *    生产者在 reserve() 与 commit() 之间崩溃 (或者消费者在清零与推进 head 之间崩溃) 会留下一条永远
+ *    不会提交的记录, 消费者确认对端已经退出之后调用 unblock() 把它变成填充记录跳过。
+ */
+class ShmRing
+{
+public:
+  enum Mode
+  {
+    kSingleProducer = 1,
+    kMultiProducer = 2,
+  };
+
+  ShmRing(const ShmRing &ring) = delete;
+  ShmRing &operator=(const ShmRing &ring) = delete;
+
+  // memory 指向共享段的起始位置 (至少按缓存行对齐). 段还没有初始化时由第一个构造者初始化,
+  // 否则直接附着, mode 必须与初始化时一致。数据区大小为 bytes 减去头部后向下取整的 2 的幂
+  ShmRing(void *memory, size_t bytes, Mode mode);
+
+  Mode mode() const { return static_cast<Mode>(header_->mode); }
+  size_t capacity() const { return capacity_; }
+  // 单条记录的最大长度
+  size_t maxRecordSize() const { return maxRecordSize_; }
+
+  // 生产者: 预留 len 字节, 空间不足时返回 NULL
+  void *tryReserve(size_t len);
+  // 生产者: 空间不足时在 futex 上等待, timeoutUsec < 0 表示一直等, 超时返回 NULL
+  void *reserve(size_t len, int64_t timeoutUsec = -1);
+  // 生产者: 提交 reserve 得到的记录, notify 为 true 时如果消费者在睡眠就唤醒它。
+  // 连续提交一批记录时可以只在最后一条 (或者单独调用 notifyConsumer()) 通知, 减少唤醒次数;
+  // reserve() 因为空间不足而睡眠之前会自己通知
+  void commit(void *data, bool notify = true);
+  void notifyConsumer();
+
+  // 消费者: 对已经提交的记录 (按提交顺序, 最多 limit 条) 调用 handler(const char *data, size_t len),
+  // 返回处理的记录数. handler 返回之后记录所在的空间就会被复用, 不能保存 data 指针
+  template <typename Handler>
+  size_t read(Handler handler, size_t limit = static_cast<size_t>(-1));
+  // 消费者: 等待直到有已提交的记录, timeoutUsec < 0 表示一直等, 超时返回 false
+  bool waitForData(int64_t timeoutUsec = -1);
+  bool empty() const;
+
+  // 消费者: 对端崩溃后调用, 把 head 处永远不会提交的记录改为填充记录, 返回是否做了修改。
+  // 生产者还活着时调用会破坏正在写入的记录
+  bool unblock();
+
+private:
+  struct RecordHeader
+  {
+    uint32_t size; // 头部 + 数据的长度 (未对齐), reserve 时写入
+    uint32_t type; // 0: 未提交, kRecordData, kRecordPadding
+  };
+
+  // 放在共享段开头, 生产者和消费者各自写的字段分别占据独立的缓存行
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t mode;
+    uint64_t capacity;
+    alignas(POSIX_CACHELINE_SIZE) uint64_t tail; // 生产者预留到的位置 (单调增长, 取模得到下标)
+    alignas(POSIX_CACHELINE_SIZE) uint64_t head; // 消费者读到的位置
+    alignas(POSIX_CACHELINE_SIZE) uint32_t dataSignal;
+    uint32_t consumerWaiting;
+    alignas(POSIX_CACHELINE_SIZE) uint32_t spaceSignal;
+    uint32_t producersWaiting;
+  };
+
+  static const uint32_t kMagic = 0x53524e47; // "SRNG"
+  static const uint32_t kInitializing = 1;
+  static const uint32_t kRecordData = 1;
+  static const uint32_t kRecordPadding = 2;
+  static const size_t kAlignment = sizeof(RecordHeader);
+
+  static size_t align(size_t size) { return (size + kAlignment - 1) & ~(kAlignment - 1); }
+  RecordHeader *headerAt(uint64_t position) const
+  {
+    return reinterpret_cast<RecordHeader *>(data_ + (position & mask_));
+  }
+  void release(uint64_t from, uint64_t to);
+
+private:
+  Header *header_;
+  char *data_;
+  size_t capacity_;
+  uint64_t mask_;
+  size_t maxRecordSize_;
+};
+
+template <typename Handler>
+size_t ShmRing::read(Handler handler, size_t limit)
+{
+  const uint64_t start = detail::atomicLoad(&header_->head, __ATOMIC_RELAXED);
+  uint64_t head = start;
+  size_t count = 0;
+  // 最多读一圈: 推进 head 之前, 读过的记录头部仍然是非 0 的
+  while (count < limit && head - start < capacity_)
+  {
+    RecordHeader *record = headerAt(head);
+    uint32_t type = detail::atomicLoad(&record->type, __ATOMIC_ACQUIRE);
+    if (type == 0)
+    {
+      break;
+    }
+    if (type == kRecordData)
+    {
+      handler(reinterpret_cast<const char *>(record + 1), record->size - sizeof(RecordHeader));
+      ++count;
+    }
+    head += align(record->size);
+  }
+  if (head != start)
+  {
+    release(start, head);
+  }
+  return count;
+}
+
+__POSIX_THREAD_END
+#endif // !__SHM_RING_H__
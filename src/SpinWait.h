@@ -0,0 +1,96 @@
+#ifndef __SPIN_WAIT_H__
+#define __SPIN_WAIT_H__
+
+#include "posix_define.h"
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// 自旋等待时提示 CPU: x86 上是 pause, 降低功耗, 也让出超线程的执行资源
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+} // namespace detail
+
+/**
+ * SpinWait: 自旋等待的退避策略 (参考 .NET SpinWait), 库里所有 "等另一个线程马上完成某件事" 的循环共用。
+ *
+ *  while (!condition())
+ *  {
+ *    spin.spinOnce();
+ *  }
+ *
+ *  1. 前 kSpinRounds 次执行 pause, 每次的个数翻倍 (1, 2, 4, ... 64), 等待时间在几百纳秒以内时不离开 CPU;
+ *  2. 之后 kYieldRounds 次调用 sched_yield(), 对方线程被切换出去时 (例如线程数多于 CPU 数) 让它先运行;
+ *  3. 再之后每次睡眠, 睡眠时间从 kMinSleepNanos 翻倍到 kMaxSleepNanos, 长时间等待不会占满一个 CPU。
+ *
+ *  等待时间可能很长的场合仍然应当用 Condition/EventCount/futex, SpinWait 只是兜底。
+ */
+class SpinWait
+{
+public:
+  static const int kSpinRounds = 7;
+  static const int kYieldRounds = 8;
+  static const int64_t kMinSleepNanos = 10 * 1000;
+  static const int64_t kMaxSleepNanos = 1000 * 1000;
+
+  SpinWait()
+      : count_(0)
+  {
+  }
+
+  void spinOnce()
+  {
+    if (count_ < kSpinRounds)
+    {
+      for (int i = 0; i < (1 << count_); ++i)
+      {
+        detail::cpuRelax();
+      }
+    }
+    else if (count_ < kSpinRounds + kYieldRounds)
+    {
+      ::sched_yield();
+    }
+    else
+    {
+      int shift = count_ - kSpinRounds - kYieldRounds;
+      int64_t nanos = shift < 7 ? kMinSleepNanos << shift : kMaxSleepNanos;
+      nanos = nanos < kMaxSleepNanos ? nanos : kMaxSleepNanos;
+      struct timespec ts;
+      ts.tv_sec = 0;
+      ts.tv_nsec = static_cast<long>(nanos);
+      ::nanosleep(&ts, NULL);
+    }
+    if (count_ < kSpinRounds + kYieldRounds + 7)
+    {
+      ++count_;
+    }
+  }
+
+  // 下一次 spinOnce() 是否会让出 CPU (yield 或睡眠)
+  bool nextSpinWillYield() const { return count_ >= kSpinRounds; }
+
+  int count() const { return count_; }
+
+  void reset() { count_ = 0; }
+
+private:
+  int count_;
+};
+
+__POSIX_THREAD_END
+#endif // !__SPIN_WAIT_H__
@@ -0,0 +1,185 @@
+#include "Strand.h"
+#include "Atomic.h"
+#include "thread_pool.h"
+#include "SpinWait.h"
+#include <assert.h>
+
+__POSIX_THREAD_BEGIN
+
+namespace
+{
+
+__thread const Strand *t_currentStrand = NULL;
+
+} // namespace
+
+Strand::Strand(const Executor &executor, int batchBudget)
+    : executor_(executor),
+      batchBudget_(batchBudget),
+      pending_(0),
+      head_(&stub_),
+      tail_(&stub_)
+{
+  assert(batchBudget > 0);
+  stub_.next = NULL;
+  stats_.executed = 0;
+  stats_.batches = 0;
+  stats_.yields = 0;
+}
+
+// 线程池没有运行时不会执行 drain: 在当前线程执行, 否则 pending_ 不会归零, 析构函数一直等下去
+Strand::Strand(ThreadPool *pool, int batchBudget)
+    : Strand([pool](Task task) {
+        if (!pool->run(task))
+        {
+          task();
+        }
+      }, batchBudget)
+{
+}
+
+Strand::~Strand()
+{
+  SpinWait spin;
+  while (detail::atomicLoad(&pending_, __ATOMIC_ACQUIRE) != 0)
+  {
+    spin.spinOnce();
+  }
+}
+
+void Strand::post(Task task)
+{
+  Node *node = new Node;
+  node->task = std::move(task);
+  push(node);
+  if (detail::atomicFetchAdd(&pending_, static_cast<int64_t>(1), __ATOMIC_ACQ_REL) == 0)
+  {
+    executor_(std::bind(&Strand::drain, this));
+  }
+}
+
+void Strand::dispatch(Task task)
+{
+  if (runningInThisThread())
+  {
+    task();
+  }
+  else
+  {
+    post(std::move(task));
+  }
+}
+
+bool Strand::runningInThisThread() const
+{
+  return t_currentStrand == this;
+}
+
+StrandStats Strand::stats() const
+{
+  StrandStats stats;
+  stats.executed = detail::atomicLoad(&stats_.executed, __ATOMIC_RELAXED);
+  stats.batches = detail::atomicLoad(&stats_.batches, __ATOMIC_RELAXED);
+  stats.yields = detail::atomicLoad(&stats_.yields, __ATOMIC_RELAXED);
+  return stats;
+}
+
+// 生产者: 先把自己换到 head_, 再把前一个节点的 next 指向自己。两步之间消费者看到的链表是断开的
+void Strand::push(Node *node)
+{
+  detail::atomicStore(&node->next, static_cast<Node *>(NULL), __ATOMIC_RELAXED);
+  Node *prev = detail::atomicExchange(&head_, node, __ATOMIC_ACQ_REL);
+  detail::atomicStore(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+// 消费者: 返回 NULL 表示队列为空, 或者有生产者正在 push 的两步之间
+Strand::Node *Strand::pop()
+{
+  Node *tail = tail_;
+  Node *next = detail::atomicLoad(&tail->next, __ATOMIC_ACQUIRE);
+  if (tail == &stub_)
+  {
+    if (next == NULL)
+    {
+      return NULL;
+    }
+    tail_ = next;
+    tail = next;
+    next = detail::atomicLoad(&next->next, __ATOMIC_ACQUIRE);
+  }
+  if (next != NULL)
+  {
+    tail_ = next;
+    return tail;
+  }
+  if (tail != detail::atomicLoad(&head_, __ATOMIC_ACQUIRE))
+  {
+    return NULL;
+  }
+  // tail 是最后一个节点: 放回 stub 之后 tail 才能被取走
+  push(&stub_);
+  next = detail::atomicLoad(&tail->next, __ATOMIC_ACQUIRE);
+  if (next != NULL)
+  {
+    tail_ = next;
+    return tail;
+  }
+  return NULL;
+}
+
+// 同一时刻只有一个线程在执行 drain (pending_ 从 0 变为非 0 时才提交, 减回 0 之前不会再提交)
+void Strand::drain()
+{
+  const Strand *outer = t_currentStrand;
+  t_currentStrand = this;
+
+  int64_t executed = 0;
+  SpinWait spin;
+  while (executed < batchBudget_)
+  {
+    Node *node = pop();
+    if (node == NULL)
+    {
+      if (detail::atomicLoad(&pending_, __ATOMIC_ACQUIRE) > executed)
+      {
+        // 计数已经加上了, 节点还没有链上, 生产者马上就会完成 push
+        spin.spinOnce();
+        continue;
+      }
+      break;
+    }
+    try
+    {
+      node->task();
+    }
+    catch (...)
+    {
+      // 抛出异常的任务也算执行过: 计数必须配平, 否则 strand 不会再被调度, 析构函数也会一直等下去
+      delete node;
+      finishDrain(outer, executed + 1);
+      throw;
+    }
+    delete node;
+    ++executed;
+    // 每拿到一个节点重新开始退避, 下一次等待 push 时先自旋而不是直接睡眠
+    spin.reset();
+  }
+  finishDrain(outer, executed);
+}
+
+void Strand::finishDrain(const Strand *outer, int64_t executed)
+{
+  detail::relaxedAdd(&stats_.executed, static_cast<uint64_t>(executed));
+  detail::relaxedAdd(&stats_.batches, static_cast<uint64_t>(1));
+  t_currentStrand = outer;
+
+  int64_t remaining = detail::atomicFetchAdd(&pending_, -executed, __ATOMIC_ACQ_REL) - executed;
+  if (remaining > 0)
+  {
+    // 用完预算或者刚好有新任务到达: 重新排到执行器队尾, 让其他任务也有机会执行
+    detail::relaxedAdd(&stats_.yields, static_cast<uint64_t>(1));
+    executor_(std::bind(&Strand::drain, this));
+  }
+}
+
+__POSIX_THREAD_END
@@ -0,0 +1,87 @@
+#ifndef __STRAND_H__
+#define __STRAND_H__
+
+#include "posix_define.h"
+#include <functional>
+#include <stdint.h>
+
+__POSIX_THREAD_BEGIN
+
+class ThreadPool;
+
+struct StrandStats
+{
+  uint64_t executed; // 执行过的任务数
+  uint64_t batches;  // 被调度到执行器上运行的次数
+  uint64_t yields;   // 用完 batchBudget 之后还有任务, 主动让出执行器重新排队的次数
+};
+
+/**
+ * Strand (参考 asio::strand): 把同一个逻辑对象上的任务串行化, 用来替代 "每个方法都加一把 MutexLock"。
+ *
+ *  任务 post() 到 strand, 而不是直接 post 到执行器: 同一时刻最多只有一个执行器线程在执行某个 strand 的任务,
+ *  任务按 post 的顺序执行, 所以任务内访问对象的状态不需要加锁。post() 不会阻塞, 工作线程也不会为了等锁而阻塞;
+ *  对象很热时, 任务在 strand 的队列中排队, 其他工作线程可以去执行别的任务。
+ *
+ *  - 队列是 Vyukov 的侵入式 MPSC 队列: post() 只有一次原子交换 + 一次 store, 没有锁。
+ *  - pending_ 计数同时充当 "已调度" 标志: 让计数从 0 变成 1 的 post() 负责把 drain 提交给执行器,
+ *    其余 post() 只入队; drain 结束时减去执行的个数, 仍有剩余就重新提交自己。
+ *  - 每次 drain 最多执行 batchBudget 个任务, 之后重新排到执行器队尾, 避免一个忙碌的 strand 长期占住工作线程。
+ *
+ *  任务抛出的异常会在记账完成之后从 drain 继续抛给执行器 (与直接 post 到执行器的任务一样处理),
+ *  strand 本身保持可用, 后面的任务照常执行。
+ *
+ *  executor 可以是任何 "把一个 std::function<void()> 交给某个线程执行" 的函数, 例如 ThreadPool::run。
+ *  析构时等待所有已经 post 的任务执行完, 所以执行器必须在 strand 析构之后才能停止;
+ *  使用 ThreadPool 时例外: 线程池停止之后 post() 的任务在调用者线程执行。
+ */
+class Strand
+{
+public:
+  using Task = std::function<void()>;
+  using Executor = std::function<void(Task)>;
+
+  Strand(const Strand &strand) = delete;
+  Strand &operator=(const Strand &strand) = delete;
+
+  explicit Strand(const Executor &executor, int batchBudget = 64);
+  explicit Strand(ThreadPool *pool, int batchBudget = 64);
+  ~Strand();
+
+  // 可以在任何线程调用, 不会阻塞 (除非执行器本身阻塞, 例如 ThreadPool 设置了 maxQueueSize)
+  void post(Task task);
+  // 当前线程正在执行这个 strand 的任务时直接执行, 否则 post()
+  void dispatch(Task task);
+  bool runningInThisThread() const;
+
+  StrandStats stats() const;
+
+private:
+  struct Node
+  {
+    Node *next;
+    Task task;
+  };
+
+  void push(Node *node);
+  Node *pop();
+  void drain();
+  // drain 结束 (包括任务抛出异常) 时调用: 恢复 t_currentStrand, 减去已执行的个数, 还有剩余就重新提交
+  void finishDrain(const Strand *outer, int64_t executed);
+
+private:
+  Executor executor_;
+  const int64_t batchBudget_;
+  int64_t pending_; // 已经 post 但还没执行完的任务数
+
+  // 生产者只写 head_, 消费者 (当前执行 drain 的线程) 只写 tail_, 分开在两个缓存行
+  char pad0_[POSIX_CACHELINE_SIZE];
+  Node *head_;
+  char pad1_[POSIX_CACHELINE_SIZE];
+  Node *tail_;
+  Node stub_;
+  StrandStats stats_;
+};
+
+__POSIX_THREAD_END
+#endif // !__STRAND_H__
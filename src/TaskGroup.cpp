@@ -0,0 +1,100 @@
+#include "TaskGroup.h"
+#include "thread_pool.h"
+
+__POSIX_THREAD_BEGIN
+
+TaskGroup::TaskGroup(ThreadPool *pool, const CancellationToken &token)
+    : pool_(pool),
+      token_(token),
+      mutex_(),
+      done_(mutex_),
+      pending_(0),
+      skipped_(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  if (detail::atomicLoad(&pending_, __ATOMIC_ACQUIRE) > 0)
+  {
+    cancel();
+  }
+  waitForChildren();
+}
+
+void TaskGroup::spawn(Task task)
+{
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    detail::atomicStore(&pending_, pending_ + 1, __ATOMIC_RELAXED);
+  }
+  if (!pool_->run([this, task]() { runChild(task); }))
+  {
+    // 线程池没有运行, 子任务不会被执行: 在当前线程执行, 否则 wait() 永远等不到计数归零
+    runChild(task);
+  }
+}
+
+void TaskGroup::wait()
+{
+  waitForChildren();
+
+  std::exception_ptr exception;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    exception.swap(exception_);
+  }
+  if (exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
+
+void TaskGroup::runChild(const Task &task)
+{
+  std::exception_ptr exception;
+  if (token_.isCancelled())
+  {
+    detail::atomicFetchAdd(&skipped_, static_cast<uint64_t>(1), __ATOMIC_RELAXED);
+  }
+  else
+  {
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      exception = std::current_exception();
+      token_.cancel();
+    }
+  }
+
+  // 在锁内减少计数: 等待者在锁内看到 0 之后才会返回 (进而析构 TaskGroup), 此后子任务不再访问 this
+  MutexLockGuard<MutexLock> lock(mutex_);
+  if (exception && !exception_)
+  {
+    exception_ = exception;
+  }
+  detail::atomicStore(&pending_, pending_ - 1, __ATOMIC_RELEASE);
+  if (pending_ == 0)
+  {
+    done_.SignalAll();
+  }
+}
+
+void TaskGroup::waitForChildren()
+{
+  // 线程池队列中还有任务就帮忙执行 (可能是本组的子任务, 也可能是别人的任务)
+  while (detail::atomicLoad(&pending_, __ATOMIC_ACQUIRE) > 0 && pool_->tryRunOne())
+  {
+  }
+
+  MutexLockGuard<MutexLock> lock(mutex_);
+  while (pending_ > 0)
+  {
+    done_.Wait();
+  }
+}
+
+__POSIX_THREAD_END
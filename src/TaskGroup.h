@@ -0,0 +1,92 @@
+#ifndef __TASK_GROUP_H__
+#define __TASK_GROUP_H__
+
+#include "posix_thread.h"
+#include "Atomic.h"
+#include <exception>
+#include <functional>
+#include <memory>
+
+__POSIX_THREAD_BEGIN
+
+class ThreadPool;
+
+/**
+ * CancellationToken: 协作式取消标志, 拷贝之间共享同一个标志。
+ *
+ *  任务在循环中定期调用 isCancelled(), 只是一次 relaxed load (没有锁, 没有 lock 前缀),
+ *  可以放在很热的循环里; 看到取消之后由任务自己决定怎样尽快返回。
+ */
+class CancellationToken
+{
+public:
+  CancellationToken()
+      : state_(std::make_shared<State>())
+  {
+  }
+
+  void cancel() const { detail::atomicStore(&state_->cancelled, 1, __ATOMIC_RELAXED); }
+  bool isCancelled() const { return detail::atomicLoad(&state_->cancelled, __ATOMIC_RELAXED) != 0; }
+
+private:
+  struct State
+  {
+    State() : cancelled(0) {}
+    int cancelled;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * TaskGroup: 结构化并发, 一组子任务 spawn() 到线程池, 由 wait() 统一收尾 (参考 TBB task_group)。
+ *
+ *  - wait() 不在条件变量上干等: 只要线程池队列中还有任务, 就在当前线程执行 (ThreadPool::tryRunOne),
+ *    所以线程池的工作线程里也可以创建 TaskGroup 并 wait(), 不会因为所有线程都在等待而死锁;
+ *    队列空了但子任务还在别的线程上执行时才睡眠。
+ *  - 子任务抛出的第一个异常被保存下来并取消整个组, wait() 在所有子任务结束后把它重新抛出, 其余异常被丢弃。
+ *  - cancel() (或者第一个异常) 之后, 还在队列中没有开始执行的子任务直接跳过;
+ *    正在执行的子任务通过 token().isCancelled() 自行提前返回。
+ *  - 构造时可以传入外部的 token (例如整个请求的取消标志), 多个 TaskGroup 共享同一个取消标志。
+ *
+ *  析构时如果还有子任务没有结束, 先取消再等待 (不抛出异常), 子任务可以安全地引用栈上的变量。
+ */
+class TaskGroup
+{
+public:
+  using Task = std::function<void()>;
+
+  TaskGroup(const TaskGroup &group) = delete;
+  TaskGroup &operator=(const TaskGroup &group) = delete;
+
+  explicit TaskGroup(ThreadPool *pool, const CancellationToken &token = CancellationToken());
+  ~TaskGroup();
+
+  // 线程池没有运行 (还没 start 或者已经 stop) 时子任务在调用者线程执行
+  void spawn(Task task);
+  // 等待所有子任务结束, 有子任务抛出异常时重新抛出第一个异常。wait() 之后可以继续 spawn()
+  void wait();
+
+  void cancel() { token_.cancel(); }
+  bool isCancelled() const { return token_.isCancelled(); }
+  const CancellationToken &token() const { return token_; }
+
+  // 因为已经取消而没有执行的子任务数
+  uint64_t skipped() const { return detail::atomicLoad(&skipped_, __ATOMIC_RELAXED); }
+
+private:
+  void runChild(const Task &task);
+  void waitForChildren();
+
+private:
+  ThreadPool *pool_;
+  CancellationToken token_;
+  MutexLock mutex_;
+  Condition done_;
+  int64_t pending_; // 已经 spawn 还没有结束的子任务数, 在 mutex_ 内修改, 帮忙干活时无锁读取
+  uint64_t skipped_;
+  std::exception_ptr exception_;
+};
+
+__POSIX_THREAD_END
+#endif // !__TASK_GROUP_H__
@@ -0,0 +1,91 @@
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+#include "FastClock.h"
+#include <stdint.h>
+#include <time.h>
+
+__POSIX_THREAD_BEGIN
+
+/**
+ * Timestamp: 单调时钟上的一个时间点 (参考 muduo Timestamp), 内部是 CLOCK_MONOTONIC 时间轴上的纳秒数。
+ *
+ *  now() 读 FastClock, 只是一个 int64_t, 按值传递。不是墙上时间, 不能用来显示日期,
+ *  但是可以与 clock_gettime(CLOCK_MONOTONIC) 得到的时间直接比较, 也可以转换成 timespec 交给
+ *  pthread_cond_timedwait/futex 等接口。
+ */
+class Timestamp
+{
+public:
+  static const int64_t kNanosPerMicro = 1000;
+  static const int64_t kNanosPerMilli = 1000 * 1000;
+  static const int64_t kNanosPerSecond = 1000 * 1000 * 1000;
+
+  Timestamp()
+      : nanos_(0)
+  {
+  }
+
+  explicit Timestamp(int64_t nanos)
+      : nanos_(nanos)
+  {
+  }
+
+  static Timestamp now() { return Timestamp(FastClock::nowNanos()); }
+  static Timestamp invalid() { return Timestamp(); }
+
+  static Timestamp fromNanos(int64_t nanos) { return Timestamp(nanos); }
+  static Timestamp fromMicros(int64_t micros) { return Timestamp(micros * kNanosPerMicro); }
+  static Timestamp fromMillis(int64_t millis) { return Timestamp(millis * kNanosPerMilli); }
+  static Timestamp fromSeconds(double seconds) { return Timestamp(static_cast<int64_t>(seconds * kNanosPerSecond)); }
+  static Timestamp fromTimespec(const struct timespec &ts)
+  {
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kNanosPerSecond + ts.tv_nsec);
+  }
+
+  bool valid() const { return nanos_ > 0; }
+
+  int64_t nanos() const { return nanos_; }
+  int64_t micros() const { return nanos_ / kNanosPerMicro; }
+  int64_t millis() const { return nanos_ / kNanosPerMilli; }
+  double seconds() const { return static_cast<double>(nanos_) / kNanosPerSecond; }
+  struct timespec toTimespec() const
+  {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(nanos_ / kNanosPerSecond);
+    ts.tv_nsec = static_cast<long>(nanos_ % kNanosPerSecond);
+    return ts;
+  }
+
+  Timestamp &operator+=(int64_t nanos)
+  {
+    nanos_ += nanos;
+    return *this;
+  }
+
+private:
+  int64_t nanos_;
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs) { return lhs.nanos() < rhs.nanos(); }
+inline bool operator>(Timestamp lhs, Timestamp rhs) { return lhs.nanos() > rhs.nanos(); }
+inline bool operator<=(Timestamp lhs, Timestamp rhs) { return lhs.nanos() <= rhs.nanos(); }
+inline bool operator>=(Timestamp lhs, Timestamp rhs) { return lhs.nanos() >= rhs.nanos(); }
+inline bool operator==(Timestamp lhs, Timestamp rhs) { return lhs.nanos() == rhs.nanos(); }
+inline bool operator!=(Timestamp lhs, Timestamp rhs) { return lhs.nanos() != rhs.nanos(); }
+
+// high - low, 单位纳秒
+inline int64_t nanosBetween(Timestamp high, Timestamp low) { return high.nanos() - low.nanos(); }
+// high - low, 单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+  return static_cast<double>(high.nanos() - low.nanos()) / Timestamp::kNanosPerSecond;
+}
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+  return Timestamp(timestamp.nanos() + static_cast<int64_t>(seconds * Timestamp::kNanosPerSecond));
+}
+inline Timestamp addNanos(Timestamp timestamp, int64_t nanos) { return Timestamp(timestamp.nanos() + nanos); }
+
+__POSIX_THREAD_END
+#endif // !__TIMESTAMP_H__
@@ -31,4 +31,7 @@
 # endif
 #endif
 
-#endif // !__POSIX_DEFINE_H__
\ No newline at end of file
+// дС, ͬ߳Ƶдݰи, α(false sharing)
+#define POSIX_CACHELINE_SIZE 64
+
+#endif // !__POSIX_DEFINE_H__
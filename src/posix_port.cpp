@@ -1,5 +1,10 @@
 #include "posix_port.h"
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
 
 __POSIX_THREAD_BEGIN
 
@@ -43,14 +48,18 @@ pthread_mutex_t *MutexLock::getPthreadMutex()
 
 bool MutexLock::IsLockedByThisThread() const
 {
-  return holder_ == pthread_self();
+  return pthread_equal(holder_, pthread_self()) != 0;
 }
 
 // Condition variable
 Condition::Condition(MutexLock &mutex)
     : mutex_(mutex)
 {
-  PthreadCall("init cv", pthread_cond_init(&cond_, NULL));
+  pthread_condattr_t attr;
+  PthreadCall("init cv attr", pthread_condattr_init(&attr));
+  PthreadCall("set cv clock", pthread_condattr_setclock(&attr, CLOCK_MONOTONIC));
+  PthreadCall("init cv", pthread_cond_init(&cond_, &attr));
+  PthreadCall("destroy cv attr", pthread_condattr_destroy(&attr));
 }
 
 Condition::~Condition()
@@ -60,7 +69,30 @@ Condition::~Condition()
 
 void Condition::Wait()
 {
+  // pthread_cond_wait 期间锁被释放, 醒来后重新持有, holder_ 需要同步更新
+  mutex_.holder_ = 0;
   PthreadCall("wait", pthread_cond_wait(&cond_, mutex_.getPthreadMutex()));
+  mutex_.holder_ = pthread_self();
+}
+
+bool Condition::WaitForSeconds(double seconds)
+{
+  const int64_t kNanoSecondsPerSecond = 1000 * 1000 * 1000;
+  struct timespec abstime;
+  ::clock_gettime(CLOCK_MONOTONIC, &abstime);
+
+  int64_t nanoseconds = abstime.tv_nsec + static_cast<int64_t>(seconds * kNanoSecondsPerSecond);
+  abstime.tv_sec += static_cast<time_t>(nanoseconds / kNanoSecondsPerSecond);
+  abstime.tv_nsec = static_cast<long>(nanoseconds % kNanoSecondsPerSecond);
+
+  mutex_.holder_ = 0;
+  int result = pthread_cond_timedwait(&cond_, mutex_.getPthreadMutex(), &abstime);
+  mutex_.holder_ = pthread_self();
+  if (result != ETIMEDOUT)
+  {
+    PthreadCall("timedwait", result);
+  }
+  return result == ETIMEDOUT;
 }
 
 void Condition::Signal()
@@ -73,4 +105,4 @@ void Condition::SignalAll()
   PthreadCall("broadcast", pthread_cond_broadcast(&cond_));
 }
 
-__POSIX_THREAD_END
\ No newline at end of file
+__POSIX_THREAD_END
@@ -62,7 +62,7 @@ private:
 
 private:
   pthread_mutex_t mutex_;
-  pid_t holder_;
+  pthread_t holder_; // 持有锁的线程, pthread_t 不能截断成 pid_t 保存
 };
 
 /**
@@ -139,6 +139,9 @@ public:
 
   void Wait();
 
+  // 最多等待 seconds 秒, 超时返回 true. 使用 CLOCK_MONOTONIC, 不受系统时间调整影响
+  bool WaitForSeconds(double seconds);
+
   void Signal();
 
   void SignalAll();
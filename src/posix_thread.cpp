@@ -1,9 +1,13 @@
 #include "posix_thread.h"
+#include "SpinWait.h"
+#include <errno.h>
 #include <time.h>
 #include <sys/prctl.h>
 #include <unistd.h>
 #include <sys/syscall.h> /* For SYS_xxx definitions */
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 
 __POSIX_THREAD_BEGIN
@@ -13,11 +17,14 @@ __POSIX_THREAD_BEGIN
 namespace CurrentThread
 {
 static const int kMicroSecondsPerSecond = 1000 * 1000;
+static const int64_t kDefaultTimerSlackNanos = 50 * 1000;
+static const int64_t kWakeupLatencyNanos = 20 * 1000; // 定时器到期后线程重新被调度运行的延迟估计
 
 __thread int t_cachedTid = 0;
 __thread char t_tidString[32];
 __thread int t_tidStringLength = 6;
 __thread const char *t_threadName = "unknown";
+static __thread int64_t t_timerSlackNanos = -1; // prctl 的结果缓存在线程里, -1 表示还没有读取
 const bool sameType = std::is_same<int, pid_t>::value;
 static_assert(sameType, "pid_t is not int type!");
 } // namespace CurrentThread
@@ -119,6 +126,55 @@ void CurrentThread::sleepUsec(int64_t usec)
   ::nanosleep(&ts, NULL);
 }
 
+void CurrentThread::sleepUntil(Timestamp deadline, int64_t spinNanos)
+{
+  if (spinNanos < 0)
+  {
+    spinNanos = timerSlackNanos() + kWakeupLatencyNanos;
+  }
+  Timestamp wakeup = addNanos(deadline, -spinNanos);
+  if (Timestamp::now() < wakeup)
+  {
+    // Timestamp 与 CLOCK_MONOTONIC 在同一时间轴上, 直接按绝对时间睡眠, 被信号打断后继续睡
+    struct timespec ts = wakeup.toTimespec();
+    while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+  }
+  while (Timestamp::now() < deadline)
+  {
+    detail::cpuRelax();
+  }
+}
+
+void CurrentThread::sleepForNanos(int64_t nanos, int64_t spinNanos)
+{
+  sleepUntil(addNanos(Timestamp::now(), nanos), spinNanos);
+}
+
+bool CurrentThread::setTimerSlackNanos(int64_t nanos)
+{
+  if (::prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(nanos), 0, 0, 0) != 0)
+  {
+    fprintf(stderr, "File:%s, Line:%d, Function:%s, prctl(PR_SET_TIMERSLACK, %lld) failed, errno:%d\n",
+            __FILE__, __LINE__, __FUNCTION__, static_cast<long long>(nanos), errno);
+    return false;
+  }
+  // 0 表示恢复默认值, 实际值下次再读
+  t_timerSlackNanos = nanos > 0 ? nanos : -1;
+  return true;
+}
+
+int64_t CurrentThread::timerSlackNanos()
+{
+  if (t_timerSlackNanos < 0)
+  {
+    int slack = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    t_timerSlackNanos = slack >= 0 ? slack : kDefaultTimerSlackNanos;
+  }
+  return t_timerSlackNanos;
+}
+
 AtomicInt32 Thread::numCreated_;
 
 Thread::Thread(const ThreadFunc &function, const std::string &name)
@@ -177,4 +233,4 @@ void Thread::setDefaultName()
     snprintf(buf, sizeof buf, "Thread%d", num);
     name_ = buf;
   }
-}
\ No newline at end of file
+}
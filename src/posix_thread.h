@@ -2,6 +2,8 @@
 #define __POSIX_THREAD_H__
 #include "CountDownLatch.h"
 #include "Atomic.h"
+#include "Timestamp.h"
+#include <string>
 
 __POSIX_THREAD_BEGIN
 
@@ -45,6 +47,20 @@ inline const char *name()
 bool isMainThread();
 
 void sleepUsec(int64_t usec);
+
+/**
+ * 高精度睡眠: nanosleep 的误差是 timer slack (默认 50us) 加上唤醒延迟, 等待几十微秒时误差比等待本身还大。
+ *  sleepUntil() 先用 clock_nanosleep 睡到 deadline 之前 spinNanos 纳秒, 剩下的时间用 pause 自旋读 FastClock,
+ *  不会早于 deadline 返回. spinNanos 为负数时取当前线程的 timer slack 加上估计的唤醒延迟。
+ *  自旋期间占满一个 CPU, 只用于发送节拍控制、轮询间隔这类对抖动敏感的循环。
+ */
+void sleepUntil(Timestamp deadline, int64_t spinNanos = -1);
+void sleepForNanos(int64_t nanos, int64_t spinNanos = -1);
+
+// 当前线程的 timer slack (prctl PR_SET_TIMERSLACK), 内核会把这个线程的定时器到期时间最多推迟这么久以合并唤醒.
+// 传入 0 恢复为默认值; 之后创建的线程继承调用者的设置. 实时调度策略 (SCHED_FIFO/RR) 的线程不受 timer slack 影响
+bool setTimerSlackNanos(int64_t nanos);
+int64_t timerSlackNanos();
 } // namespace CurrentThread
 
 class Thread
@@ -83,4 +99,4 @@ private:
 };
 
 __POSIX_THREAD_END
-#endif // !__POSIX_THREAD_H__
\ No newline at end of file
+#endif // !__POSIX_THREAD_H__
@@ -0,0 +1,559 @@
+#include "thread_pool.h"
+#include "FastClock.h"
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+
+#ifdef POSIX_THREAD_POOL_METRICS
+#define POOL_METRICS(statement) statement
+#else
+#define POOL_METRICS(statement)
+#endif
+
+__POSIX_THREAD_BEGIN
+
+namespace detail
+{
+
+// 每个工作线程槽位一份, 只有当前占用槽位的工作线程会写, stats() 用 relaxed 读
+struct WorkerMetrics
+{
+  std::string name;
+  int64_t startNs;  // 当前线程的启动时间, 槽位空闲时为 0
+  int64_t activeNs; // 之前退出的线程在该槽位上的存活时间之和
+  uint64_t tasks;
+  int64_t busyNs;
+  int64_t parkedNs;
+  uint64_t parks;
+  uint64_t unparks;
+  LatencyHistogram queueLatency;
+  LatencyHistogram runTime;
+  char pad_[POSIX_CACHELINE_SIZE]; // 与下一个工作线程的数据隔开
+
+  WorkerMetrics()
+      : startNs(0),
+        activeNs(0),
+        tasks(0),
+        busyNs(0),
+        parkedNs(0),
+        parks(0),
+        unparks(0)
+  {
+  }
+};
+
+} // namespace detail
+
+ThreadPool::ThreadPool(const std::string &name)
+    : mutex_(),
+      notEmpty_(mutex_),
+      notFull_(mutex_),
+      name_(name),
+      lanes_(1),
+      queueSize_(0),
+      maxQueueSize_(0),
+      maxQueueDepth_(0),
+      running_(false),
+      expired_(0),
+      coreThreads_(0),
+      maxThreads_(0),
+      numThreads_(0),
+      idleThreads_(0),
+      elastic_(false),
+      growThresholdNs_(0),
+      keepAliveSeconds_(0),
+      lastGrowNs_(0),
+      lastSaturatedNs_(0)
+{
+  lanes_[0].weight = 1;
+  lanes_[0].current = 0;
+  lanes_[0].deadlineStreak = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+  if (running_)
+  {
+    stop();
+  }
+}
+
+void ThreadPool::setElastic(int maxThreads, int64_t growThresholdUsec, double keepAliveSeconds)
+{
+  assert(!running_);
+  assert(maxThreads > 0);
+  elastic_ = true;
+  maxThreads_ = maxThreads;
+  growThresholdNs_ = growThresholdUsec * 1000;
+  keepAliveSeconds_ = keepAliveSeconds;
+}
+
+void ThreadPool::setPriorityWeights(const std::vector<int> &weights)
+{
+  assert(!running_);
+  assert(!weights.empty());
+  lanes_.clear();
+  lanes_.resize(weights.size());
+  for (size_t i = 0; i < weights.size(); ++i)
+  {
+    assert(weights[i] > 0);
+    lanes_[i].weight = weights[i];
+    lanes_[i].current = 0;
+    lanes_[i].deadlineStreak = 0;
+  }
+}
+
+void ThreadPool::start(int numThreads)
+{
+  assert(workers_.empty());
+  assert(!elastic_ || numThreads <= maxThreads_);
+  running_ = true;
+  coreThreads_ = numThreads;
+  if (!elastic_)
+  {
+    maxThreads_ = numThreads;
+  }
+
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    workers_.reserve(maxThreads_);
+    for (int i = 0; i < numThreads; ++i)
+    {
+      addThread();
+    }
+  }
+  if (maxThreads_ == 0 && threadInitCallback_)
+  {
+    threadInitCallback_();
+  }
+}
+
+void ThreadPool::stop()
+{
+  std::vector<Thread *> threads;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    running_ = false;
+    notEmpty_.SignalAll();
+    notFull_.SignalAll();
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+      threads.push_back(workers_[i]->thread.get());
+    }
+  }
+  // 已经退出 (retired) 但还没被回收的线程也在这里 join
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i]->join();
+  }
+}
+
+size_t ThreadPool::queueSize() const
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  return queueSize_;
+}
+
+int ThreadPool::numThreads() const
+{
+  MutexLockGuard<MutexLock> lock(mutex_);
+  return numThreads_;
+}
+
+bool ThreadPool::run(Task task)
+{
+  return run(std::move(task), 0, 0);
+}
+
+bool ThreadPool::run(Task task, int priority, int64_t timeoutUsec)
+{
+  assert(priority >= 0 && priority < static_cast<int>(lanes_.size()));
+  if (maxThreads_ == 0)
+  {
+    task();
+    return true;
+  }
+
+  MutexLockGuard<MutexLock> lock(mutex_);
+  while (isFull() && running_)
+  {
+    notFull_.Wait();
+  }
+  if (!running_)
+  {
+    return false;
+  }
+
+  int64_t now = 0;
+#ifdef POSIX_THREAD_POOL_METRICS
+  now = FastClock::nowNanos();
+#else
+  if (elastic_ || timeoutUsec > 0)
+  {
+    now = FastClock::nowNanos();
+  }
+#endif
+
+  QueuedTask queued;
+  queued.task = std::move(task);
+  queued.enqueueNs = now;
+  queued.deadlineNs = 0;
+  Lane &lane = lanes_[priority];
+  if (timeoutUsec > 0)
+  {
+    queued.deadlineNs = now + timeoutUsec * 1000;
+    lane.deadlines.push_back(std::move(queued));
+    std::push_heap(lane.deadlines.begin(), lane.deadlines.end(), LaterDeadline());
+  }
+  else
+  {
+    lane.fifo.push_back(std::move(queued));
+  }
+  ++queueSize_;
+
+  if (queueSize_ > maxQueueDepth_)
+  {
+    maxQueueDepth_ = queueSize_;
+  }
+  if (elastic_ && shouldGrow(now))
+  {
+    lastGrowNs_ = now;
+    addThread();
+  }
+  notEmpty_.Signal();
+  return true;
+}
+
+// 平滑加权轮询选出通道, 通道内先按 EDF 取带截止时间的任务, 过期的丢弃;
+// FIFO 队首已经让过 kMaxDeadlineStreak 次时轮到它. 返回出队的任务数 (含丢弃)
+size_t ThreadPool::pop(QueuedTask *out)
+{
+  assert(mutex_.IsLockedByThisThread());
+  size_t popped = 0;
+  int64_t now = 0;
+  while (queueSize_ > 0)
+  {
+    Lane *selected = NULL;
+    int totalWeight = 0;
+    for (size_t i = 0; i < lanes_.size(); ++i)
+    {
+      Lane &lane = lanes_[i];
+      if (lane.size() > 0)
+      {
+        lane.current += lane.weight;
+        totalWeight += lane.weight;
+        if (selected == NULL || lane.current > selected->current)
+        {
+          selected = &lane;
+        }
+      }
+    }
+    selected->current -= totalWeight;
+    --queueSize_;
+    ++popped;
+
+    if (selected->deadlines.empty() ||
+        (!selected->fifo.empty() && selected->deadlineStreak >= kMaxDeadlineStreak))
+    {
+      selected->deadlineStreak = 0;
+      *out = std::move(selected->fifo.front());
+      selected->fifo.pop_front();
+      return popped;
+    }
+
+    if (!selected->fifo.empty())
+    {
+      ++selected->deadlineStreak;
+    }
+    std::pop_heap(selected->deadlines.begin(), selected->deadlines.end(), LaterDeadline());
+    QueuedTask queued(std::move(selected->deadlines.back()));
+    selected->deadlines.pop_back();
+    if (now == 0)
+    {
+      now = FastClock::nowNanos();
+    }
+    if (queued.deadlineNs >= now)
+    {
+      *out = std::move(queued);
+      return popped;
+    }
+    ++expired_;
+  }
+  return popped;
+}
+
+// 各通道队首中最早的入队时间. 堆顶是截止时间最早而不一定是最早入队的任务, 这里只需要近似值
+int64_t ThreadPool::oldestEnqueueNs() const
+{
+  int64_t oldest = 0;
+  for (size_t i = 0; i < lanes_.size(); ++i)
+  {
+    const Lane &lane = lanes_[i];
+    if (!lane.fifo.empty() && (oldest == 0 || lane.fifo.front().enqueueNs < oldest))
+    {
+      oldest = lane.fifo.front().enqueueNs;
+    }
+    if (!lane.deadlines.empty() && (oldest == 0 || lane.deadlines.front().enqueueNs < oldest))
+    {
+      oldest = lane.deadlines.front().enqueueNs;
+    }
+  }
+  return oldest;
+}
+
+bool ThreadPool::shouldGrow(int64_t now) const
+{
+  assert(mutex_.IsLockedByThisThread());
+  if (numThreads_ >= maxThreads_ || idleThreads_ > 0)
+  {
+    return false;
+  }
+  if (numThreads_ == 0)
+  {
+    return true;
+  }
+  // 队首任务等得足够久, 且距离上次扩容也足够久, 才扩容 (迟滞, 避免抖动)
+  return now - oldestEnqueueNs() >= growThresholdNs_ &&
+         now - lastGrowNs_ >= growThresholdNs_;
+}
+
+// 条件变量的唤醒顺序大致是 FIFO, 流量下降后每个线程仍会轮流分到任务, 单个线程很难空闲满 keepAlive.
+// 所以按线程池整体判断: 连续 keepAlive 时间内从没出现过所有线程同时忙碌, 说明至少有一个线程是多余的.
+// 每退出一个线程重新计时, 线程数逐个回落, 不会一次退出太多
+bool ThreadPool::shouldRetire()
+{
+  assert(mutex_.IsLockedByThisThread());
+  int64_t now = FastClock::nowNanos();
+  if (now - lastSaturatedNs_ < static_cast<int64_t>(keepAliveSeconds_ * 1000 * 1000 * 1000))
+  {
+    return false;
+  }
+  lastSaturatedNs_ = now;
+  return true;
+}
+
+// 在持有 mutex_ 的情况下创建并启动线程. 扩容受阈值限制, 很少发生;
+// 被复用槽位上的旧线程已经离开 take(), 不会再申请 mutex_, 在锁内 join 不会死锁
+void ThreadPool::addThread()
+{
+  assert(mutex_.IsLockedByThisThread());
+  Worker *worker = NULL;
+  for (size_t i = 0; i < workers_.size(); ++i)
+  {
+    if (workers_[i]->retired)
+    {
+      worker = workers_[i].get();
+      worker->thread->join();
+      worker->thread.reset();
+      worker->retired = false;
+      break;
+    }
+  }
+  if (worker == NULL)
+  {
+    char id[32];
+    snprintf(id, sizeof id, "%d", static_cast<int>(workers_.size()) + 1);
+    workers_.emplace_back(new Worker);
+    worker = workers_.back().get();
+    worker->metrics.reset(new detail::WorkerMetrics);
+    worker->metrics->name = name_ + id;
+    worker->retired = false;
+  }
+
+  ++numThreads_;
+  lastSaturatedNs_ = FastClock::nowNanos();
+  POOL_METRICS(detail::atomicStore(&worker->metrics->startNs, FastClock::nowNanos(), __ATOMIC_RELAXED));
+  worker->thread.reset(new Thread(std::bind(&ThreadPool::runInThread, this, worker),
+                                  worker->metrics->name));
+  worker->thread->start();
+}
+
+bool ThreadPool::take(QueuedTask *out, Worker *worker)
+{
+  detail::WorkerMetrics *metrics = worker->metrics.get();
+  (void)metrics;
+
+  MutexLockGuard<MutexLock> lock(mutex_);
+  // always use a while-loop, due to spurious wakeup
+  while (queueSize_ == 0 && running_)
+  {
+    if (numThreads_ > coreThreads_ && shouldRetire())
+    {
+      --numThreads_;
+      worker->retired = true;
+      return false;
+    }
+
+    POOL_METRICS(int64_t parkStart = FastClock::nowNanos());
+    POOL_METRICS(detail::relaxedAdd(&metrics->parks, static_cast<uint64_t>(1)));
+    ++idleThreads_;
+    if (numThreads_ > coreThreads_)
+    {
+      // 非核心线程限时等待, 超时醒来后重新检查是否需要退出
+      notEmpty_.WaitForSeconds(keepAliveSeconds_);
+    }
+    else
+    {
+      notEmpty_.Wait();
+    }
+    --idleThreads_;
+    POOL_METRICS(detail::relaxedAdd(&metrics->unparks, static_cast<uint64_t>(1)));
+    POOL_METRICS(detail::relaxedAdd(&metrics->parkedNs, FastClock::nowNanos() - parkStart));
+  }
+  if (queueSize_ == 0)
+  {
+    return false;
+  }
+
+  return popTask(out);
+}
+
+// 出队一个任务并唤醒等待空位的 run(), take() 和 tryRunOne() 共用.
+// 队列中可能全是已经过期的任务, 丢弃之后没有可执行的任务, 返回 false
+bool ThreadPool::popTask(QueuedTask *out)
+{
+  assert(mutex_.IsLockedByThisThread());
+  QueuedTask queued;
+  size_t popped = pop(&queued);
+  if (maxQueueSize_ > 0)
+  {
+    if (popped > 1)
+    {
+      notFull_.SignalAll();
+    }
+    else
+    {
+      notFull_.Signal();
+    }
+  }
+  if (!queued.task)
+  {
+    return false;
+  }
+
+  *out = std::move(queued);
+  if (elastic_ && idleThreads_ == 0)
+  {
+    lastSaturatedNs_ = FastClock::nowNanos();
+  }
+  return true;
+}
+
+void ThreadPool::runInThread(Worker *worker)
+{
+  detail::WorkerMetrics *metrics = worker->metrics.get();
+  (void)metrics;
+  if (threadInitCallback_)
+  {
+    threadInitCallback_();
+  }
+
+  QueuedTask queued;
+  while (running_)
+  {
+    if (take(&queued, worker) && queued.task)
+    {
+      POOL_METRICS(int64_t startNs = FastClock::nowNanos());
+      POOL_METRICS(metrics->queueLatency.record(startNs - queued.enqueueNs));
+      queued.task();
+      queued.task = Task();
+      POOL_METRICS(int64_t runNs = FastClock::nowNanos() - startNs);
+      POOL_METRICS(metrics->runTime.record(runNs));
+      POOL_METRICS(detail::relaxedAdd(&metrics->busyNs, runNs));
+      POOL_METRICS(detail::relaxedAdd(&metrics->tasks, static_cast<uint64_t>(1)));
+    }
+    else if (worker->retired)
+    {
+      // retired 只在 take() 中持锁置位, 同一线程读取不需要加锁
+      break;
+    }
+  }
+
+#ifdef POSIX_THREAD_POOL_METRICS
+  int64_t startNs = detail::atomicLoad(&metrics->startNs, __ATOMIC_RELAXED);
+  detail::relaxedAdd(&metrics->activeNs, FastClock::nowNanos() - startNs);
+  detail::atomicStore(&metrics->startNs, static_cast<int64_t>(0), __ATOMIC_RELAXED);
+#endif
+}
+
+bool ThreadPool::isFull() const
+{
+  assert(mutex_.IsLockedByThisThread());
+  return maxQueueSize_ > 0 && queueSize_ >= maxQueueSize_;
+}
+
+bool ThreadPool::tryRunOne()
+{
+  QueuedTask queued;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    if (queueSize_ == 0 || !popTask(&queued))
+    {
+      return false;
+    }
+  }
+  queued.task();
+  return true;
+}
+
+ThreadPoolStats ThreadPool::stats() const
+{
+  ThreadPoolStats stats;
+  std::vector<detail::WorkerMetrics *> metrics;
+  std::vector<bool> retired;
+  {
+    MutexLockGuard<MutexLock> lock(mutex_);
+    stats.threads = numThreads_;
+    stats.queueDepth = queueSize_;
+    stats.maxQueueDepth = maxQueueDepth_;
+    stats.expired = expired_;
+    for (size_t i = 0; i < lanes_.size(); ++i)
+    {
+      stats.laneDepth.push_back(lanes_[i].size());
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+      metrics.push_back(workers_[i]->metrics.get());
+      retired.push_back(workers_[i]->retired);
+    }
+  }
+
+#ifdef POSIX_THREAD_POOL_METRICS
+  stats.enabled = true;
+  int64_t now = FastClock::nowNanos();
+#else
+  stats.enabled = false;
+#endif
+
+  // 不持有锁, 工作线程继续运行, 每个字段都是单写者 relaxed 写入, 这里 relaxed 读.
+  // 槽位只增不减, 指针在线程池析构之前一直有效
+  for (size_t i = 0; i < metrics.size(); ++i)
+  {
+    detail::WorkerMetrics *m = metrics[i];
+    ThreadPoolStats::Worker worker;
+    worker.name = m->name;
+    worker.tasks = detail::atomicLoad(&m->tasks, __ATOMIC_RELAXED);
+    worker.busyNs = detail::atomicLoad(&m->busyNs, __ATOMIC_RELAXED);
+    worker.parkedNs = detail::atomicLoad(&m->parkedNs, __ATOMIC_RELAXED);
+    worker.parks = detail::atomicLoad(&m->parks, __ATOMIC_RELAXED);
+    worker.unparks = detail::atomicLoad(&m->unparks, __ATOMIC_RELAXED);
+    worker.retired = retired[i];
+    worker.idleNs = 0;
+#ifdef POSIX_THREAD_POOL_METRICS
+    int64_t startNs = detail::atomicLoad(&m->startNs, __ATOMIC_RELAXED);
+    int64_t lifetime = detail::atomicLoad(&m->activeNs, __ATOMIC_RELAXED);
+    if (startNs > 0)
+    {
+      lifetime += now - startNs;
+    }
+    int64_t idle = lifetime - worker.busyNs - worker.parkedNs;
+    worker.idleNs = idle > 0 ? idle : 0;
+    stats.queueLatency.merge(m->queueLatency);
+    stats.runTime.merge(m->runTime);
+#endif
+    stats.workers.push_back(worker);
+  }
+  return stats;
+}
+
+__POSIX_THREAD_END
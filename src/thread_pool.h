@@ -1,11 +1,185 @@
 #ifndef __THREAD_POOL_H__
 #define __THREAD_POOL_H__
 
-#include "posix_port.h"
+#include "posix_thread.h"
+#include "LatencyHistogram.h"
+#include <deque>
+#include <memory>
+#include <vector>
 // https://blog.csdn.net/wolf909867753/article/details/77500625/
 
 __POSIX_THREAD_BEGIN
 
+/**
+ * 线程池运行时统计的快照, 由 ThreadPool::stats() 生成。
+ *
+ *  统计代码由编译宏 POSIX_THREAD_POOL_METRICS 控制 (cmake -DENABLE_POOL_METRICS=ON/OFF),
+ *  关闭时记录代码全部被编译掉, 快照中只有队列深度等不需要额外开销的数据, enabled 为 false。
+ *  所有时间单位都是纳秒。
+ */
+struct ThreadPoolStats
+{
+  struct Worker
+  {
+    std::string name;
+    uint64_t tasks;   // 执行过的任务数
+    int64_t busyNs;   // 执行任务的时间
+    int64_t idleNs;   // 既没有执行任务也没有睡眠的时间 (抢锁, 取任务等)
+    int64_t parkedNs; // 在条件变量上睡眠的时间
+    uint64_t parks;   // 因队列为空而睡眠的次数
+    uint64_t unparks; // 被唤醒的次数 (包括虚假唤醒)
+    bool retired;     // 弹性模式下空闲超时已退出, 槽位等待复用
+  };
+
+  bool enabled;
+  int threads;                  // 当前存活的工作线程数
+  size_t queueDepth;            // 当前排队的任务数
+  size_t maxQueueDepth;         // 启动以来的最大排队任务数
+  std::vector<size_t> laneDepth; // 每个优先级通道当前排队的任务数
+  uint64_t expired;             // 开始执行前已经超过截止时间而被丢弃的任务数
+  LatencyHistogram queueLatency; // 任务从入队到开始执行的延迟
+  LatencyHistogram runTime;      // 任务执行时间
+  std::vector<Worker> workers;
+};
+
+namespace detail
+{
+struct WorkerMetrics;
+} // namespace detail
+
+/**
+ * 线程池 (参考 muduo ThreadPool)
+ *
+ *  任务队列使用 MutexLock + Condition 保护, 队列满时 run() 阻塞调用者；
+ *  没有工作线程 (start(0)) 时, run() 直接在调用者线程执行任务。
+ *
+ *  队列分为多个优先级通道 (默认只有一个, 即普通的 FIFO 队列), 下标 0 优先级最高。
+ *  通道之间按权重做平滑加权轮询 (smooth weighted round-robin), 低优先级通道不会饿死,
+ *  但大批后台任务也不会把交互请求的延迟拖到秒级。通道内带截止时间的任务按 EDF
+ *  (earliest deadline first) 先执行, 取出时已经过期的任务直接丢弃, 不再执行。
+ *  同一通道内连续 kMaxDeadlineStreak 次取了带截止时间的任务后, 下一次改取 FIFO 队首,
+ *  持续不断的截止时间任务不会让同通道中没有截止时间的任务饿死。
+ *
+ *  默认线程数固定. setElastic() 打开弹性模式: start(n) 启动的 n 个是核心线程,
+ *  队首任务的排队时间超过阈值且没有空闲线程时新增线程 (不超过 maxThreads),
+ *  非核心线程在条件变量上限时等待, 线程池连续 keepAlive 时间没有满负荷时逐个退出。
+ *  扩容条件 (排队延迟高) 与缩容条件 (长时间空闲) 之间天然有间隔, 再加上两次扩容之间至少间隔
+ *  一个阈值时间, 流量抖动时线程数不会来回震荡。
+ *
+ *  每个工作线程拥有自己的统计数据 (单写者, 按缓存行隔开), stats() 在不停止工作线程的情况下
+ *  合并出一份快照, 用于根据线上数据确定线程池大小。
+ */
+class ThreadPool
+{
+public:
+  using Task = std::function<void()>;
+
+  ThreadPool(const ThreadPool &pool) = delete;
+  ThreadPool &operator=(const ThreadPool &pool) = delete;
+
+  explicit ThreadPool(const std::string &name = std::string("ThreadPool"));
+  ~ThreadPool();
+
+  // 必须在 start() 之前调用, 0 表示不限制队列长度
+  void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
+  void setThreadInitCallback(const Task &cb) { threadInitCallback_ = cb; }
+
+  // 必须在 start() 之前调用
+  void setElastic(int maxThreads, int64_t growThresholdUsec, double keepAliveSeconds);
+  // 必须在 start() 之前调用, weights.size() 即通道个数, weights[i] 为通道 i 的出队权重
+  void setPriorityWeights(const std::vector<int> &weights);
+
+  void start(int numThreads);
+  void stop();
+
+  const std::string &name() const { return name_; }
+  size_t queueSize() const;
+  int numThreads() const;
+
+  // 放入通道 0. 线程池没有运行 (还没 start 或者已经 stop) 时不接受任务, 返回 false
+  bool run(Task task);
+  // timeoutUsec > 0 时任务的截止时间为 now + timeoutUsec, 超过截止时间还没开始执行就被丢弃
+  bool run(Task task, int priority, int64_t timeoutUsec = 0);
+  // 在调用者线程执行一个排队中的任务, 队列为空时立即返回 false。
+  // 用于等待者 "帮忙干活" 而不是阻塞 (TaskGroup::wait), 执行的任务不计入工作线程的统计
+  bool tryRunOne();
+
+  ThreadPoolStats stats() const;
+
+private:
+  struct QueuedTask
+  {
+    Task task;
+    int64_t enqueueNs; // 入队时间, 用于排队延迟统计和弹性扩容, 两者都关闭时不赋值
+    int64_t deadlineNs; // 截止时间, 0 表示没有
+  };
+
+  struct LaterDeadline
+  {
+    bool operator()(const QueuedTask &lhs, const QueuedTask &rhs) const
+    {
+      return lhs.deadlineNs > rhs.deadlineNs;
+    }
+  };
+
+  // 优先级通道: 带截止时间的任务放在最小堆里, 其余任务 FIFO
+  struct Lane
+  {
+    std::deque<QueuedTask> fifo;
+    std::vector<QueuedTask> deadlines;
+    int weight;
+    int current;        // 平滑加权轮询的当前权重
+    int deadlineStreak; // FIFO 非空时连续从堆中取任务的次数
+
+    size_t size() const { return fifo.size() + deadlines.size(); }
+  };
+
+  // 工作线程槽位, 退出的线程被 join 之后槽位 (连同统计数据) 由新线程复用,
+  // 所以槽位个数不超过最大线程数
+  struct Worker
+  {
+    std::unique_ptr<Thread> thread;
+    std::unique_ptr<detail::WorkerMetrics> metrics;
+    bool retired;
+  };
+
+  // 同一通道内 FIFO 队首最多让给带截止时间的任务的次数
+  static const int kMaxDeadlineStreak = 8;
+
+  bool isFull() const;
+  bool shouldGrow(int64_t now) const;
+  bool shouldRetire();
+  int64_t oldestEnqueueNs() const;
+  size_t pop(QueuedTask *out);
+  bool popTask(QueuedTask *out);
+  void addThread();
+  void runInThread(Worker *worker);
+  bool take(QueuedTask *out, Worker *worker);
+
+private:
+  mutable MutexLock mutex_;
+  Condition notEmpty_;
+  Condition notFull_;
+  std::string name_;
+  Task threadInitCallback_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<Lane> lanes_;
+  size_t queueSize_;
+  size_t maxQueueSize_;
+  size_t maxQueueDepth_;
+  bool running_;
+  uint64_t expired_;
+
+  int coreThreads_;
+  int maxThreads_;
+  int numThreads_;  // 存活的工作线程数
+  int idleThreads_; // 在 notEmpty_ 上睡眠的工作线程数
+  bool elastic_;
+  int64_t growThresholdNs_;
+  double keepAliveSeconds_;
+  int64_t lastGrowNs_;
+  int64_t lastSaturatedNs_; // 最近一次所有线程同时忙碌的时间
+};
 
 __POSIX_THREAD_END
-#endif // !__THREAD_POOL_H__
\ No newline at end of file
+#endif // !__THREAD_POOL_H__
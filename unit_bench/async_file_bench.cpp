@@ -0,0 +1,95 @@
+#include "bench.h"
+#include <AsyncFile.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+/**
+ * 4K 随机读写, 队列深度固定为 depth: 在飞的请求数达到 depth 时 read()/write() 阻塞。
+ *   auto       : 内核支持时用 io_uring (注册文件和缓冲区), 否则与 threadpool 相同
+ *   threadpool : depth 个线程 pread/pwrite
+ *  一个请求计一次操作, 延迟是每次提交的耗时 (队列满时包括等待空位的时间)。
+ *  文件建在 $TMPDIR (默认 /tmp) 下, 打开之后立即删除。只有一个提交线程, 框架扫描更多线程数时不重复输出。
+ */
+const size_t kBlock = 4096;
+const size_t kFileSize = 16 * 1024 * 1024;
+
+int openTempFile()
+{
+  const char *dir = ::getenv("TMPDIR");
+  std::string pattern = std::string(dir != NULL && dir[0] != '\0' ? dir : "/tmp") + "/async_file_bench.XXXXXX";
+  std::vector<char> path(pattern.begin(), pattern.end());
+  path.push_back('\0');
+  int fd = ::mkstemp(path.data());
+  if (fd >= 0)
+  {
+    ::unlink(path.data());
+  }
+  return fd;
+}
+
+template <PosixThread::AsyncFile::Backend backend, int depth, bool isWrite>
+void randomIo(int, int64_t durationNs, BenchResult *result)
+{
+  result->threads = 1;
+  int fd = openTempFile();
+  if (fd < 0)
+  {
+    return;
+  }
+  std::vector<char> fill(kFileSize, 'z');
+  void *memory = NULL;
+  if (::pwrite(fd, fill.data(), kFileSize, 0) != static_cast<ssize_t>(kFileSize) ||
+      ::posix_memalign(&memory, kBlock, kBlock * depth) != 0)
+  {
+    ::close(fd);
+    return;
+  }
+  memset(memory, 'y', kBlock * depth);
+
+  {
+    PosixThread::AsyncFile file(depth, backend, depth);
+    if (file.backend() == PosixThread::AsyncFile::kIoUring)
+    {
+      struct iovec iov;
+      iov.iov_base = memory;
+      iov.iov_len = kBlock * depth;
+      file.registerBuffers(std::vector<struct iovec>(1, iov));
+      file.registerFiles(std::vector<int>(1, fd));
+    }
+
+    unsigned seed = 1;
+    int next = 0;
+    runLoop(1, durationNs, 1, [&](int) {
+      char *buf = static_cast<char *>(memory) + (next++ % depth) * kBlock;
+      off_t offset = static_cast<off_t>(rand_r(&seed) % (kFileSize / kBlock)) * kBlock;
+      if (isWrite)
+      {
+        file.write(fd, buf, kBlock, offset, [](ssize_t) {});
+      }
+      else
+      {
+        file.read(fd, buf, kBlock, offset, [](ssize_t) {});
+      }
+      return 1;
+    }, result);
+  } // ~AsyncFile 等待在飞的请求完成
+  ::free(memory);
+  ::close(fd);
+}
+
+BENCHMARK("async_file_randread_qd1", "auto", (randomIo<PosixThread::AsyncFile::kAuto, 1, false>));
+BENCHMARK("async_file_randread_qd1", "threadpool", (randomIo<PosixThread::AsyncFile::kThreadPool, 1, false>));
+BENCHMARK("async_file_randread_qd32", "auto", (randomIo<PosixThread::AsyncFile::kAuto, 32, false>));
+BENCHMARK("async_file_randread_qd32", "threadpool", (randomIo<PosixThread::AsyncFile::kThreadPool, 32, false>));
+BENCHMARK("async_file_randwrite_qd1", "auto", (randomIo<PosixThread::AsyncFile::kAuto, 1, true>));
+BENCHMARK("async_file_randwrite_qd1", "threadpool", (randomIo<PosixThread::AsyncFile::kThreadPool, 1, true>));
+BENCHMARK("async_file_randwrite_qd32", "auto", (randomIo<PosixThread::AsyncFile::kAuto, 32, true>));
+BENCHMARK("async_file_randwrite_qd32", "threadpool", (randomIo<PosixThread::AsyncFile::kThreadPool, 32, true>));
+
+} // namespace
@@ -0,0 +1,256 @@
+#include "bench.h"
+#include <Atomic.h>
+#include <CountDownLatch.h>
+#include <FastClock.h>
+#include <posix_thread.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+struct BenchCase
+{
+  std::string name;
+  std::string impl;
+  BenchFunc func;
+};
+
+std::vector<BenchCase> &registry()
+{
+  static std::vector<BenchCase> cases;
+  return cases;
+}
+
+int g_stop = 0;
+
+// 每个线程一份, 按缓存行隔开
+struct ThreadResult
+{
+  PosixThread::LatencyHistogram latency;
+  uint64_t ops;
+  char pad_[POSIX_CACHELINE_SIZE];
+};
+
+struct Options
+{
+  int maxThreads;
+  int64_t durationNs;
+  std::string filter;
+  bool json;
+};
+
+void usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s [--max-threads N] [--duration-ms MS] [--filter SUBSTR] [--format csv|json]\n"
+          "  sweeps thread counts 1, 2, 4, ... N (default: max(4, 2 * online CPUs))\n",
+          program);
+}
+
+bool parseOptions(int argc, char *argv[], Options *options)
+{
+  long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+  options->maxThreads = cpus * 2 > 4 ? static_cast<int>(cpus * 2) : 4;
+  options->durationNs = 200 * 1000 * 1000;
+  options->json = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (::strcmp(arg, "--help") == 0 || value == NULL)
+    {
+      return false;
+    }
+    if (::strcmp(arg, "--max-threads") == 0)
+    {
+      options->maxThreads = ::atoi(value);
+    }
+    else if (::strcmp(arg, "--duration-ms") == 0)
+    {
+      options->durationNs = ::atoll(value) * 1000 * 1000;
+    }
+    else if (::strcmp(arg, "--filter") == 0)
+    {
+      options->filter = value;
+    }
+    else if (::strcmp(arg, "--format") == 0)
+    {
+      options->json = ::strcmp(value, "json") == 0;
+    }
+    else
+    {
+      return false;
+    }
+    ++i;
+  }
+  return options->maxThreads > 0 && options->durationNs > 0;
+}
+
+void print(const BenchResult &result, bool json, bool first)
+{
+  double seconds = result.elapsedNs / 1e9;
+  double opsPerSecond = seconds > 0 ? result.ops / seconds : 0.0;
+  const PosixThread::LatencyHistogram &latency = result.latency;
+  if (json)
+  {
+    printf("%s\n    {\"benchmark\": \"%s\", \"impl\": \"%s\", \"threads\": %d, \"batch\": %d, \"ops\": %llu, "
+           "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"p50_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld, \"max_ns\": %lld}",
+           first ? "" : ",", result.name.c_str(), result.impl.c_str(), result.threads, result.batch,
+           static_cast<unsigned long long>(result.ops), seconds, opsPerSecond,
+           static_cast<long long>(latency.percentile(50)), static_cast<long long>(latency.percentile(99)),
+           static_cast<long long>(latency.percentile(99.9)), static_cast<long long>(latency.max()));
+  }
+  else
+  {
+    printf("%s,%s,%d,%d,%llu,%.6f,%.1f,%lld,%lld,%lld,%lld\n", result.name.c_str(), result.impl.c_str(),
+           result.threads, result.batch, static_cast<unsigned long long>(result.ops), seconds, opsPerSecond,
+           static_cast<long long>(latency.percentile(50)), static_cast<long long>(latency.percentile(99)),
+           static_cast<long long>(latency.percentile(99.9)), static_cast<long long>(latency.max()));
+  }
+  fflush(stdout);
+}
+
+} // namespace
+
+BenchRegistrar::BenchRegistrar(const char *name, const char *impl, const BenchFunc &func)
+{
+  BenchCase benchCase;
+  benchCase.name = name;
+  benchCase.impl = impl;
+  benchCase.func = func;
+  registry().push_back(benchCase);
+}
+
+bool stopped()
+{
+  return PosixThread::detail::atomicLoad(&g_stop, __ATOMIC_RELAXED) != 0;
+}
+
+void runLoop(int threads, int64_t durationNs, int batch, const std::function<int(int thread)> &body,
+             BenchResult *result, const std::function<void()> &onStop)
+{
+  std::vector<std::unique_ptr<ThreadResult>> results;
+  for (int t = 0; t < threads; ++t)
+  {
+    results.emplace_back(new ThreadResult());
+    results.back()->ops = 0;
+  }
+  PosixThread::detail::atomicStore(&g_stop, 0, __ATOMIC_RELAXED);
+  PosixThread::CountDownLatch ready(threads);
+  PosixThread::CountDownLatch go(1);
+
+  std::vector<std::unique_ptr<PosixThread::Thread>> workers;
+  for (int t = 0; t < threads; ++t)
+  {
+    ThreadResult *mine = results[t].get();
+    workers.emplace_back(new PosixThread::Thread([&, t, mine]() {
+      ready.CountDown();
+      go.Wait();
+      while (!stopped())
+      {
+        uint64_t start = PosixThread::FastClock::ticks();
+        int ops = 0;
+        for (int i = 0; i < batch; ++i)
+        {
+          ops += body(t);
+        }
+        uint64_t end = PosixThread::FastClock::ticksOrdered();
+        if (ops > 0)
+        {
+          mine->latency.record(PosixThread::FastClock::ticksToNanos(static_cast<int64_t>(end - start)) / ops);
+          mine->ops += ops;
+        }
+      }
+    }, "BenchWorker"));
+    workers.back()->start();
+  }
+
+  ready.Wait();
+  int64_t start = PosixThread::FastClock::nowNanos();
+  go.CountDown();
+  ::usleep(static_cast<useconds_t>(durationNs / 1000));
+  PosixThread::detail::atomicStore(&g_stop, 1, __ATOMIC_RELAXED);
+  if (onStop)
+  {
+    onStop();
+  }
+  for (int t = 0; t < threads; ++t)
+  {
+    workers[t]->join();
+  }
+  result->elapsedNs = PosixThread::FastClock::nowNanos() - start;
+  result->batch = batch;
+  result->ops = 0;
+  for (int t = 0; t < threads; ++t)
+  {
+    result->latency.merge(results[t]->latency);
+    result->ops += results[t]->ops;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  Options options;
+  if (!parseOptions(argc, argv, &options))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<int> threadCounts;
+  for (int threads = 1; threads < options.maxThreads; threads *= 2)
+  {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(options.maxThreads);
+
+  if (options.json)
+  {
+    printf("{\n  \"benchmarks\": [");
+  }
+  else
+  {
+    printf("benchmark,impl,threads,batch,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+  }
+  bool first = true;
+  const std::vector<BenchCase> &cases = registry();
+  for (size_t i = 0; i < cases.size(); ++i)
+  {
+    const BenchCase &benchCase = cases[i];
+    if (!options.filter.empty() && benchCase.name.find(options.filter) == std::string::npos)
+    {
+      continue;
+    }
+    int lastThreads = 0;
+    for (size_t j = 0; j < threadCounts.size(); ++j)
+    {
+      std::unique_ptr<BenchResult> result(new BenchResult());
+      result->name = benchCase.name;
+      result->impl = benchCase.impl;
+      result->threads = threadCounts[j];
+      result->batch = 1;
+      result->ops = 0;
+      result->elapsedNs = 0;
+      fprintf(stderr, "running %s/%s with %d threads\n", benchCase.name.c_str(), benchCase.impl.c_str(), threadCounts[j]);
+      benchCase.func(threadCounts[j], options.durationNs, result.get());
+      // 有的基准测试需要成对的线程, 会调整线程数, 调整后与上一次相同就不再输出
+      if (result->threads == lastThreads)
+      {
+        continue;
+      }
+      lastThreads = result->threads;
+      print(*result, options.json, first);
+      first = false;
+    }
+  }
+  if (options.json)
+  {
+    printf("\n  ]\n}\n");
+  }
+  return 0;
+}
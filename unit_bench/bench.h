@@ -0,0 +1,50 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <LatencyHistogram.h>
+#include <functional>
+#include <string>
+
+/**
+ * posix_thread_bench.exx 的基准测试框架: 每个基准测试按线程数 1, 2, 4, ... maxThreads 各运行一次,
+ * 输出吞吐量 (ops/s) 和单次操作延迟的 p50/p99/p999 (CSV 或 JSON), 作为以后修改各个构件时的回归基线。
+ *
+ *  每个基准测试有一个 impl 名字: "posix" 是本库的实现, "std" 是对照用的标准库实现。
+ *  延迟用 FastClock 计时; 操作本身只有几纳秒时每 batch 次操作计一次时, 记录的是这一批的平均值。
+ */
+struct BenchResult
+{
+  std::string name;
+  std::string impl;
+  int threads;
+  int batch;
+  uint64_t ops;
+  int64_t elapsedNs;
+  PosixThread::LatencyHistogram latency; // 单次操作的延迟, 纳秒
+};
+
+// threads: 本次运行的线程数; durationNs: 运行时间. 结果写入 result (name/impl/threads 由框架填好)
+using BenchFunc = std::function<void(int threads, int64_t durationNs, BenchResult *result)>;
+
+struct BenchRegistrar
+{
+  BenchRegistrar(const char *name, const char *impl, const BenchFunc &func);
+};
+
+#define BENCH_CONCAT_INNER(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_INNER(a, b)
+#define BENCHMARK(name, impl, func) \
+  static BenchRegistrar BENCH_CONCAT(benchRegistrar_, __LINE__)(name, impl, func)
+
+/**
+ * 启动 threads 个线程, 每个线程反复调用 body(thread) 直到 durationNs 结束。
+ *  body 返回这一次调用完成的操作数 (例如 ping-pong 中只有发起方计数, 应答方返回 0);
+ *  连续 batch 次调用计一次时。stop 置位之后框架调用 onStop (如果有), 用来唤醒睡在条件变量上的线程,
+ *  body 看到 stopped() 为 true 时应当尽快返回。
+ */
+void runLoop(int threads, int64_t durationNs, int batch, const std::function<int(int thread)> &body,
+             BenchResult *result, const std::function<void()> &onStop = std::function<void()>());
+
+bool stopped();
+
+#endif // !__BENCH_H__
@@ -0,0 +1,48 @@
+#include "bench.h"
+#include <FastClock.h>
+#include <memory>
+#include <time.h>
+
+namespace
+{
+
+// 每个线程把读数累加到自己的 sink 里, 防止读时钟被优化掉
+struct Sink
+{
+  int64_t value;
+  char pad_[POSIX_CACHELINE_SIZE];
+};
+
+/**
+ * 读一次时钟的开销:
+ *   clock_gettime : clock_gettime(CLOCK_MONOTONIC), 走 vDSO, 时钟源不是 tsc 时会陷入内核
+ *   fast_now      : FastClock::nowNanos(), 读 TSC 再换算成纳秒
+ *   fast_ticks    : FastClock::ticks(), 只读 TSC
+ */
+template <typename Read>
+void clockRead(int threads, int64_t durationNs, BenchResult *result, Read read)
+{
+  std::unique_ptr<Sink[]> sinks(new Sink[threads]);
+  runLoop(threads, durationNs, 64, [&](int thread) {
+    sinks[thread].value += read();
+    return 1;
+  }, result);
+}
+
+BENCHMARK("clock_read", "clock_gettime", [](int threads, int64_t durationNs, BenchResult *result) {
+  clockRead(threads, durationNs, result, []() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_nsec);
+  });
+});
+
+BENCHMARK("clock_read", "fast_now", [](int threads, int64_t durationNs, BenchResult *result) {
+  clockRead(threads, durationNs, result, []() { return PosixThread::FastClock::nowNanos(); });
+});
+
+BENCHMARK("clock_read", "fast_ticks", [](int threads, int64_t durationNs, BenchResult *result) {
+  clockRead(threads, durationNs, result, []() { return static_cast<int64_t>(PosixThread::FastClock::ticks()); });
+});
+
+} // namespace
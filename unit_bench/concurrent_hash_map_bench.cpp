@@ -0,0 +1,89 @@
+#include "bench.h"
+#include <ConcurrentHashMap.h>
+#include <memory>
+#include <unordered_map>
+
+namespace
+{
+
+// 单锁 unordered_map 对照组
+class LockedMap
+{
+public:
+  bool find(int64_t key, int64_t *value) const
+  {
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex_);
+    std::unordered_map<int64_t, int64_t>::const_iterator it = map_.find(key);
+    if (it == map_.end())
+    {
+      return false;
+    }
+    *value = it->second;
+    return true;
+  }
+
+  void upsert(int64_t key, int64_t value)
+  {
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex_);
+    map_[key] = value;
+  }
+
+private:
+  mutable PosixThread::MutexLock mutex_;
+  std::unordered_map<int64_t, int64_t> map_;
+};
+
+// 每个线程一个随机数状态, 按缓存行隔开
+struct Seed
+{
+  uint64_t value;
+  char pad_[POSIX_CACHELINE_SIZE];
+};
+
+/**
+ * 读写混合: 10 万个键先插入一半, 每个线程随机选键, readPercent% 的操作是 find, 其余是 upsert。
+ *  posix 是 16 个分片的 ConcurrentHashMap, std 是一把 MutexLock 保护的 unordered_map。
+ */
+template <typename Map, int readPercent>
+void readWriteMix(int threads, int64_t durationNs, BenchResult *result)
+{
+  const int64_t kKeySpace = 100000;
+  Map map;
+  for (int64_t i = 0; i < kKeySpace; i += 2)
+  {
+    map.upsert(i, i);
+  }
+  std::unique_ptr<Seed[]> seeds(new Seed[threads]);
+  for (int t = 0; t < threads; ++t)
+  {
+    seeds[t].value = 88172645463325252ULL + t;
+  }
+
+  runLoop(threads, durationNs, 64, [&](int thread) {
+    uint64_t &seed = seeds[thread].value;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    int64_t key = static_cast<int64_t>(seed % kKeySpace);
+    if (static_cast<int>(seed >> 40) % 100 < readPercent)
+    {
+      int64_t value = 0;
+      map.find(key, &value);
+    }
+    else
+    {
+      map.upsert(key, key);
+    }
+    return 1;
+  }, result);
+}
+
+// 默认构造的 ConcurrentHashMap 是 16 个分片
+typedef PosixThread::ConcurrentHashMap<int64_t, int64_t> ShardedMap;
+
+BENCHMARK("hash_map_read90", "posix", (readWriteMix<ShardedMap, 90>));
+BENCHMARK("hash_map_read90", "std", (readWriteMix<LockedMap, 90>));
+BENCHMARK("hash_map_read50", "posix", (readWriteMix<ShardedMap, 50>));
+BENCHMARK("hash_map_read50", "std", (readWriteMix<LockedMap, 50>));
+
+} // namespace
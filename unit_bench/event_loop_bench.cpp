@@ -0,0 +1,42 @@
+#include "bench.h"
+#include <Atomic.h>
+#include <CountDownLatch.h>
+#include <EventLoop.h>
+#include <EventLoopThread.h>
+#include <sched.h>
+
+namespace
+{
+
+/**
+ * 跨线程投递回调: threads 个生产者线程不断 queueInLoop(), 由一个 loop 线程执行。
+ *  一次 queueInLoop() 计一次操作; 在途的回调最多 kMaxInFlight 个, 超过时生产者等待,
+ *  所以吞吐量受 loop 线程的执行速度限制, 反映每次唤醒能批量执行多少回调。
+ */
+const int64_t kMaxInFlight = 64 * 1024;
+
+BENCHMARK("event_loop_cross_thread_functor", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::EventLoopThread loopThread(PosixThread::EventLoopThread::ThreadInitCallback(), "BenchLoop");
+  PosixThread::EventLoop *loop = loopThread.startLoop();
+
+  int64_t queued = 0;
+  int64_t executed = 0; // 只在 loop 线程中修改
+  runLoop(threads, durationNs, 16, [&](int) {
+    if (PosixThread::detail::atomicLoad(&queued, __ATOMIC_RELAXED) -
+            PosixThread::detail::atomicLoad(&executed, __ATOMIC_RELAXED) >= kMaxInFlight)
+    {
+      ::sched_yield();
+      return 0;
+    }
+    PosixThread::detail::atomicFetchAdd(&queued, static_cast<int64_t>(1), __ATOMIC_RELAXED);
+    loop->queueInLoop([&executed]() { PosixThread::detail::relaxedAdd(&executed, static_cast<int64_t>(1)); });
+    return 1;
+  }, result);
+
+  // 回调按投递的顺序执行, 最后一个执行完时前面的都已经执行完
+  PosixThread::CountDownLatch done(1);
+  loop->queueInLoop([&done]() { done.CountDown(); });
+  done.Wait();
+});
+
+} // namespace
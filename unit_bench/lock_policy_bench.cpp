@@ -0,0 +1,59 @@
+#include "bench.h"
+#include <ConcurrentHashMap.h>
+#include <CountDownLatch.h>
+#include <LockPolicy.h>
+#include <memory>
+
+namespace
+{
+
+/**
+ * 单线程批处理工具的场景: 同样的 CountDownLatch/ConcurrentHashMap 代码只换锁策略 (LockPolicy.h),
+ * 测量 NullMutex 省下的加锁开销。NullMutex 不能跨线程共享, 所以这几个基准测试总是只用一个线程,
+ * 框架扫描更多线程数时结果与上一行相同, 不会重复输出。
+ */
+template <typename Mutex>
+void latchCountDown(int, int64_t durationNs, BenchResult *result)
+{
+  const int kCount = 1 << 20;
+  result->threads = 1;
+  std::unique_ptr<PosixThread::BasicCountDownLatch<Mutex>> latch(new PosixThread::BasicCountDownLatch<Mutex>(kCount));
+  runLoop(1, durationNs, 64, [&](int) {
+    if (latch->GetCount() == 0)
+    {
+      latch.reset(new PosixThread::BasicCountDownLatch<Mutex>(kCount));
+    }
+    latch->CountDown();
+    return 1;
+  }, result);
+}
+
+BENCHMARK("latch_countdown_single_thread", "null", latchCountDown<PosixThread::NullMutex>);
+BENCHMARK("latch_countdown_single_thread", "spin", latchCountDown<PosixThread::SpinLock>);
+BENCHMARK("latch_countdown_single_thread", "futex", latchCountDown<PosixThread::FastMutex>);
+BENCHMARK("latch_countdown_single_thread", "posix", latchCountDown<PosixThread::MutexLock>);
+
+// 一次 upsert 加一次 find 计一次操作, 键在 64K 个之间循环, 表的大小稳定后不再扩容
+template <typename Mutex>
+void hashMapUpsertFind(int, int64_t durationNs, BenchResult *result)
+{
+  const uint32_t kKeys = 1 << 16;
+  result->threads = 1;
+  PosixThread::ConcurrentHashMap<uint32_t, uint64_t, std::hash<uint32_t>, std::equal_to<uint32_t>, Mutex> map(
+      16, kKeys / 4);
+  uint32_t next = 0;
+  runLoop(1, durationNs, 64, [&](int) {
+    uint32_t key = next++ & (kKeys - 1);
+    map.upsert(key, 1, [](uint64_t &value) { ++value; });
+    uint64_t value = 0;
+    map.find(key * 7 & (kKeys - 1), &value);
+    return value != UINT64_MAX ? 1 : 0;
+  }, result);
+}
+
+BENCHMARK("hash_map_single_thread", "null", hashMapUpsertFind<PosixThread::NullMutex>);
+BENCHMARK("hash_map_single_thread", "spin", hashMapUpsertFind<PosixThread::SpinLock>);
+BENCHMARK("hash_map_single_thread", "futex", hashMapUpsertFind<PosixThread::FastMutex>);
+BENCHMARK("hash_map_single_thread", "posix", hashMapUpsertFind<PosixThread::MutexLock>);
+
+} // namespace
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include <Pipeline.h>
+#include <string>
+
+namespace
+{
+
+/**
+ * ETL 链: 读取 (串行) -> 编码 (并行) -> 写出 (串行有序), 用 threads 个线程、threads * 4 个令牌运行。
+ *  每次调用跑完 kChunks 个 64KB 的数据块, 一个数据块计一次操作, 延迟是这一趟中每个数据块的平均耗时。
+ */
+const int kChunks = 16;
+const size_t kChunkSize = 64 * 1024;
+
+struct Chunk
+{
+  int index;
+  std::string input;
+  std::string output;
+};
+
+// 游程编码, 每个字节再做几轮整数运算, 模拟解析/压缩这类 CPU 密集的阶段
+void encode(Chunk &chunk)
+{
+  chunk.output.clear();
+  size_t i = 0;
+  while (i < chunk.input.size())
+  {
+    size_t j = i;
+    uint32_t hash = 2166136261u;
+    while (j < chunk.input.size() && chunk.input[j] == chunk.input[i] && j - i < 255)
+    {
+      for (int round = 0; round < 4; ++round)
+      {
+        hash = (hash ^ static_cast<unsigned char>(chunk.input[j])) * 16777619u;
+      }
+      ++j;
+    }
+    chunk.output.push_back(static_cast<char>(j - i));
+    chunk.output.push_back(static_cast<char>(chunk.input[i] ^ (hash & 1)));
+    i = j;
+  }
+}
+
+BENCHMARK("pipeline_etl", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  int next = 0;
+  uint64_t written = 0;
+  PosixThread::Pipeline<Chunk> pipeline("Etl");
+  pipeline.source([&](Chunk &chunk) {
+            if (next == kChunks)
+            {
+              return false;
+            }
+            chunk.index = next++;
+            chunk.input.resize(kChunkSize);
+            for (size_t i = 0; i < kChunkSize; ++i)
+            {
+              chunk.input[i] = static_cast<char>('a' + (i * 7 + chunk.index) % 13);
+            }
+            return true;
+          })
+      .stage("encode", PosixThread::Pipeline<Chunk>::kParallel, encode)
+      .stage("write", PosixThread::Pipeline<Chunk>::kSerialInOrder, [&](Chunk &chunk) {
+        written += chunk.output.size();
+      });
+
+  runLoop(1, durationNs, 1, [&](int) {
+    next = 0;
+    pipeline.run(threads, threads * 4);
+    return written > 0 ? kChunks : 0;
+  }, result);
+});
+
+} // namespace
@@ -0,0 +1,406 @@
+#include "bench.h"
+#include <Atomic.h>
+#include <CountDownLatch.h>
+#include <EventCount.h>
+#include <LockPolicy.h>
+#include <ParkingLot.h>
+#include <posix_thread.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// 每个线程一把锁, 按缓存行隔开, 测量没有竞争时加锁/解锁的开销
+template <typename Mutex>
+struct PaddedMutex
+{
+  Mutex mutex;
+  int64_t counter;
+  char pad_[POSIX_CACHELINE_SIZE];
+};
+
+template <typename Mutex, typename Guard>
+void uncontendedMutex(int threads, int64_t durationNs, BenchResult *result)
+{
+  std::unique_ptr<PaddedMutex<Mutex>[]> mutexes(new PaddedMutex<Mutex>[threads]);
+  runLoop(threads, durationNs, 64, [&](int thread) {
+    PaddedMutex<Mutex> &mine = mutexes[thread];
+    Guard lock(mine.mutex);
+    ++mine.counter;
+    return 1;
+  }, result);
+}
+
+template <typename Mutex, typename Guard>
+void contendedMutex(int threads, int64_t durationNs, BenchResult *result)
+{
+  Mutex mutex;
+  int64_t counter = 0;
+  runLoop(threads, durationNs, 8, [&](int) {
+    Guard lock(mutex);
+    ++counter;
+    return 1;
+  }, result);
+}
+
+BENCHMARK("mutex_uncontended", "posix",
+          (uncontendedMutex<PosixThread::MutexLock, PosixThread::MutexLockGuard<PosixThread::MutexLock>>));
+BENCHMARK("mutex_uncontended", "std", (uncontendedMutex<std::mutex, std::lock_guard<std::mutex>>));
+BENCHMARK("mutex_contended", "posix",
+          (contendedMutex<PosixThread::MutexLock, PosixThread::MutexLockGuard<PosixThread::MutexLock>>));
+BENCHMARK("mutex_contended", "std", (contendedMutex<std::mutex, std::lock_guard<std::mutex>>));
+
+// 其他锁策略 (LockPolicy.h). 每个线程一把锁时 NullMutex 也是安全的, 它给出的是锁本身的开销为零时的基线
+BENCHMARK("mutex_uncontended", "null",
+          (uncontendedMutex<PosixThread::NullMutex, PosixThread::MutexLockGuard<PosixThread::NullMutex>>));
+BENCHMARK("mutex_uncontended", "spin",
+          (uncontendedMutex<PosixThread::SpinLock, PosixThread::MutexLockGuard<PosixThread::SpinLock>>));
+BENCHMARK("mutex_uncontended", "futex",
+          (uncontendedMutex<PosixThread::FastMutex, PosixThread::MutexLockGuard<PosixThread::FastMutex>>));
+BENCHMARK("mutex_contended", "spin",
+          (contendedMutex<PosixThread::SpinLock, PosixThread::MutexLockGuard<PosixThread::SpinLock>>));
+BENCHMARK("mutex_contended", "futex",
+          (contendedMutex<PosixThread::FastMutex, PosixThread::MutexLockGuard<PosixThread::FastMutex>>));
+
+BENCHMARK("atomic_increment", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::AtomicInt64 value;
+  runLoop(threads, durationNs, 64, [&](int) {
+    value.increment();
+    return 1;
+  }, result);
+});
+
+BENCHMARK("atomic_increment", "std", [](int threads, int64_t durationNs, BenchResult *result) {
+  std::atomic<int64_t> value(0);
+  runLoop(threads, durationNs, 64, [&](int) {
+    value.fetch_add(1);
+    return 1;
+  }, result);
+});
+
+// 读者与一个不停写的线程 (线程 0, 只有一个线程时没有写者) 竞争同一个缓存行:
+// AtomicInt64::get() 是 CAS, 读也会独占缓存行
+BENCHMARK("atomic_get", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::AtomicInt64 value;
+  runLoop(threads, durationNs, 64, [&](int thread) {
+    if (thread == 0 && threads > 1)
+    {
+      value.increment();
+      return 0;
+    }
+    return value.get() >= 0 ? 1 : 0;
+  }, result);
+});
+
+BENCHMARK("atomic_get", "std", [](int threads, int64_t durationNs, BenchResult *result) {
+  std::atomic<int64_t> value(0);
+  runLoop(threads, durationNs, 64, [&](int thread) {
+    if (thread == 0 && threads > 1)
+    {
+      value.fetch_add(1);
+      return 0;
+    }
+    return value.load() >= 0 ? 1 : 0;
+  }, result);
+});
+
+// threads / 2 对线程, 每对通过条件变量交替唤醒对方, 一次往返计一次操作
+void conditionPingPong(int threads, int64_t durationNs, BenchResult *result)
+{
+  struct Pair
+  {
+    Pair() : cond(mutex), turn(0) {}
+    PosixThread::MutexLock mutex;
+    PosixThread::Condition cond;
+    int turn;
+    char pad_[POSIX_CACHELINE_SIZE];
+  };
+
+  int pairs = threads / 2 > 0 ? threads / 2 : 1;
+  result->threads = pairs * 2;
+  std::unique_ptr<Pair[]> state(new Pair[pairs]);
+  runLoop(pairs * 2, durationNs, 1, [&](int thread) {
+    Pair &pair = state[thread / 2];
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(pair.mutex);
+    if (thread % 2 == 0)
+    {
+      pair.turn = 1;
+      pair.cond.Signal();
+      while (pair.turn != 0 && !stopped())
+      {
+        pair.cond.Wait();
+      }
+      return pair.turn == 0 ? 1 : 0;
+    }
+    while (pair.turn != 1 && !stopped())
+    {
+      pair.cond.Wait();
+    }
+    pair.turn = 0;
+    pair.cond.Signal();
+    return 0;
+  }, result, [&]() {
+    for (int i = 0; i < pairs; ++i)
+    {
+      PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(state[i].mutex);
+      state[i].cond.SignalAll();
+    }
+  });
+}
+
+void stdConditionPingPong(int threads, int64_t durationNs, BenchResult *result)
+{
+  struct Pair
+  {
+    Pair() : turn(0) {}
+    std::mutex mutex;
+    std::condition_variable cond;
+    int turn;
+    char pad_[POSIX_CACHELINE_SIZE];
+  };
+
+  int pairs = threads / 2 > 0 ? threads / 2 : 1;
+  result->threads = pairs * 2;
+  std::unique_ptr<Pair[]> state(new Pair[pairs]);
+  runLoop(pairs * 2, durationNs, 1, [&](int thread) {
+    Pair &pair = state[thread / 2];
+    std::unique_lock<std::mutex> lock(pair.mutex);
+    if (thread % 2 == 0)
+    {
+      pair.turn = 1;
+      pair.cond.notify_one();
+      while (pair.turn != 0 && !stopped())
+      {
+        pair.cond.wait(lock);
+      }
+      return pair.turn == 0 ? 1 : 0;
+    }
+    while (pair.turn != 1 && !stopped())
+    {
+      pair.cond.wait(lock);
+    }
+    pair.turn = 0;
+    pair.cond.notify_one();
+    return 0;
+  }, result, [&]() {
+    for (int i = 0; i < pairs; ++i)
+    {
+      std::lock_guard<std::mutex> lock(state[i].mutex);
+      state[i].cond.notify_all();
+    }
+  });
+}
+
+BENCHMARK("condition_pingpong", "posix", conditionPingPong);
+BENCHMARK("condition_pingpong", "std", stdConditionPingPong);
+
+// 线程 0 每一轮创建一个计数为 threads - 1 的 CountDownLatch 并广播, 其余线程各 CountDown 一次,
+// 线程 0 从广播到 Wait() 返回计一次操作
+void latchFanIn(int threads, int64_t durationNs, BenchResult *result)
+{
+  PosixThread::MutexLock mutex;
+  PosixThread::Condition newRound(mutex);
+  uint64_t generation = 0;
+  std::shared_ptr<PosixThread::CountDownLatch> current;
+  std::vector<uint64_t> seen(threads, 0);
+
+  runLoop(threads, durationNs, 1, [&](int thread) {
+    if (thread == 0)
+    {
+      std::shared_ptr<PosixThread::CountDownLatch> latch = std::make_shared<PosixThread::CountDownLatch>(threads - 1);
+      {
+        PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex);
+        current = latch;
+        ++generation;
+        newRound.SignalAll();
+      }
+      latch->Wait();
+      return 1;
+    }
+    std::shared_ptr<PosixThread::CountDownLatch> latch;
+    {
+      PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex);
+      while (generation == seen[thread] && !stopped())
+      {
+        newRound.Wait();
+      }
+      if (generation == seen[thread])
+      {
+        return 0;
+      }
+      seen[thread] = generation;
+      latch = current;
+    }
+    latch->CountDown();
+    return 0;
+  }, result, [&]() {
+    // 已经退出的线程不会再领取最后一轮, 替它们 CountDown, 线程 0 才不会永远等下去
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex);
+    for (int t = 1; t < threads; ++t)
+    {
+      if (seen[t] != generation)
+      {
+        seen[t] = generation;
+        current->CountDown();
+      }
+    }
+    newRound.SignalAll();
+  });
+}
+
+// 标准库 (C++11) 没有 latch, 用 mutex + condition_variable + 计数器做对照
+void stdLatchFanIn(int threads, int64_t durationNs, BenchResult *result)
+{
+  struct Latch
+  {
+    explicit Latch(int count) : count(count) {}
+    std::mutex mutex;
+    std::condition_variable cond;
+    int count;
+  };
+
+  std::mutex mutex;
+  std::condition_variable newRound;
+  uint64_t generation = 0;
+  std::shared_ptr<Latch> current;
+  std::vector<uint64_t> seen(threads, 0);
+
+  runLoop(threads, durationNs, 1, [&](int thread) {
+    if (thread == 0)
+    {
+      std::shared_ptr<Latch> latch = std::make_shared<Latch>(threads - 1);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = latch;
+        ++generation;
+        newRound.notify_all();
+      }
+      std::unique_lock<std::mutex> lock(latch->mutex);
+      while (latch->count > 0)
+      {
+        latch->cond.wait(lock);
+      }
+      return 1;
+    }
+    std::shared_ptr<Latch> latch;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (generation == seen[thread] && !stopped())
+      {
+        newRound.wait(lock);
+      }
+      if (generation == seen[thread])
+      {
+        return 0;
+      }
+      seen[thread] = generation;
+      latch = current;
+    }
+    std::lock_guard<std::mutex> lock(latch->mutex);
+    if (--latch->count == 0)
+    {
+      latch->cond.notify_all();
+    }
+    return 0;
+  }, result, [&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int t = 1; t < threads; ++t)
+    {
+      if (seen[t] != generation)
+      {
+        seen[t] = generation;
+        std::lock_guard<std::mutex> latchLock(current->mutex);
+        if (--current->count == 0)
+        {
+          current->cond.notify_all();
+        }
+      }
+    }
+    newRound.notify_all();
+  });
+}
+
+BENCHMARK("latch_fan_in", "posix", latchFanIn);
+BENCHMARK("latch_fan_in", "std", stdLatchFanIn);
+
+BENCHMARK("thread_spawn_join", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  runLoop(threads, durationNs, 1, [](int) {
+    PosixThread::Thread thread([]() {}, "BenchSpawn");
+    thread.start();
+    thread.join();
+    return 1;
+  }, result);
+});
+
+BENCHMARK("thread_spawn_join", "std", [](int threads, int64_t durationNs, BenchResult *result) {
+  runLoop(threads, durationNs, 1, [](int) {
+    std::thread thread([]() {});
+    thread.join();
+    return 1;
+  }, result);
+});
+
+/**
+ * 没有等待者时通知一次的开销, 所有线程通知同一个对象:
+ *   event_count : EventCount::notify(), 没有等待者时只读一次状态
+ *   condition   : Condition::Signal()
+ *   parking_lot : ParkingLot::unparkOne(), 要查一次哈希桶
+ *   std         : std::condition_variable::notify_one()
+ */
+BENCHMARK("notify_no_waiter", "event_count", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::EventCount ec;
+  runLoop(threads, durationNs, 64, [&](int) {
+    ec.notify();
+    return 1;
+  }, result);
+});
+
+BENCHMARK("notify_no_waiter", "condition", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::MutexLock mutex;
+  PosixThread::Condition cond(mutex);
+  runLoop(threads, durationNs, 64, [&](int) {
+    cond.Signal();
+    return 1;
+  }, result);
+});
+
+BENCHMARK("notify_no_waiter", "parking_lot", [](int threads, int64_t durationNs, BenchResult *result) {
+  uint32_t word = 0;
+  runLoop(threads, durationNs, 64, [&](int) {
+    PosixThread::ParkingLot::unparkOne(&word);
+    return 1;
+  }, result);
+});
+
+BENCHMARK("notify_no_waiter", "std", [](int threads, int64_t durationNs, BenchResult *result) {
+  std::condition_variable cond;
+  runLoop(threads, durationNs, 64, [&](int) {
+    cond.notify_one();
+    return 1;
+  }, result);
+});
+
+// 有一个等待者一直在等永远不会成立的条件: 每次 notify 都要修改 epoch 并调用 futex wake
+BENCHMARK("notify_one_waiter", "event_count", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::EventCount ec;
+  int stop = 0;
+  PosixThread::Thread waiter([&]() {
+    ec.await([&]() { return PosixThread::detail::atomicLoad(&stop) != 0; });
+  }, "EventCountWaiter");
+  waiter.start();
+  PosixThread::CurrentThread::sleepUsec(10 * 1000);
+  runLoop(threads, durationNs, 16, [&](int) {
+    ec.notify();
+    return 1;
+  }, result);
+  PosixThread::detail::atomicStore(&stop, 1);
+  ec.notifyAll();
+  waiter.join();
+});
+
+} // namespace
@@ -0,0 +1,123 @@
+#include "bench.h"
+#include <ShmRing.h>
+#include <memory>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+/**
+ * 跨进程传递 64 字节的小记录, 生产者是 fork 出来的子进程, 一直写到被父进程杀掉, 父进程读:
+ *   shm_ring    : 共享内存环形缓冲区, 每 kBatch 条记录通知一次
+ *   unix_socket : 每 kBatch 条记录一次 write/read 的 Unix socket
+ *  一条记录计一次操作. 只有一对进程, 框架扫描更多线程数时不重复输出。
+ */
+const size_t kRecordSize = 64;
+const size_t kBatch = 64;
+
+void stopChild(pid_t pid)
+{
+  ::kill(pid, SIGKILL);
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+}
+
+BENCHMARK("ipc_64b_records", "shm_ring", [](int, int64_t durationNs, BenchResult *result) {
+  result->threads = 1;
+  std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::createAnonymous("ShmRingBench", 1024 * 1024);
+  if (!segment)
+  {
+    return;
+  }
+  PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kSingleProducer);
+
+  pid_t pid = ::fork();
+  if (pid < 0)
+  {
+    return;
+  }
+  if (pid == 0)
+  {
+    for (uint64_t i = 0;; ++i)
+    {
+      char *data = static_cast<char *>(ring.reserve(kRecordSize));
+      memcpy(data, &i, sizeof i);
+      ring.commit(data, i % kBatch == kBatch - 1);
+    }
+  }
+
+  uint64_t sum = 0;
+  runLoop(1, durationNs, 1, [&](int) {
+    if (!ring.waitForData(1000))
+    {
+      return 0;
+    }
+    return static_cast<int>(ring.read([&](const char *data, size_t) {
+      uint64_t value;
+      memcpy(&value, data, sizeof value);
+      sum += value;
+    }));
+  }, result);
+  stopChild(pid);
+});
+
+BENCHMARK("ipc_64b_records", "unix_socket", [](int, int64_t durationNs, BenchResult *result) {
+  result->threads = 1;
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+  {
+    return;
+  }
+  pid_t pid = ::fork();
+  if (pid < 0)
+  {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return;
+  }
+  if (pid == 0)
+  {
+    ::close(fds[0]);
+    std::vector<char> batch(kRecordSize * kBatch);
+    for (uint64_t i = 0;; i += kBatch)
+    {
+      for (size_t j = 0; j < kBatch; ++j)
+      {
+        uint64_t value = i + j;
+        memcpy(&batch[j * kRecordSize], &value, sizeof value);
+      }
+      size_t written = 0;
+      while (written < batch.size())
+      {
+        ssize_t n = ::write(fds[1], &batch[written], batch.size() - written);
+        if (n <= 0)
+        {
+          ::_exit(1);
+        }
+        written += n;
+      }
+    }
+  }
+  ::close(fds[1]);
+
+  std::vector<char> buffer(kRecordSize * kBatch);
+  uint64_t bytes = 0;
+  runLoop(1, durationNs, 1, [&](int) {
+    uint64_t records = bytes / kRecordSize;
+    ssize_t n = ::read(fds[0], buffer.data(), buffer.size());
+    if (n > 0)
+    {
+      bytes += n;
+    }
+    return static_cast<int>(bytes / kRecordSize - records);
+  }, result);
+  stopChild(pid);
+  ::close(fds[0]);
+});
+
+} // namespace
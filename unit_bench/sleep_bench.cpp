@@ -0,0 +1,77 @@
+#include "bench.h"
+#include <Timestamp.h>
+#include <posix_thread.h>
+#include <memory>
+#include <time.h>
+#include <vector>
+
+namespace
+{
+
+/**
+ * 睡眠抖动: 每个线程反复睡 50us, 记录实际醒来的时间比预定时间晚了多少。
+ *  这几个基准测试输出的 p50/p99/p999/max 是迟到的纳秒数 (不是睡眠的总时间), ops_per_sec 是每秒醒来的次数。
+ *   nanosleep       : 直接调用 nanosleep, 误差里包含默认 50us 的 timer slack
+ *   nanosleep_slack : 先把线程的 timer slack 设成 1ns 再 nanosleep
+ *   sleep_until     : CurrentThread::sleepUntil, 提前醒来再自旋到预定时间
+ */
+const int64_t kSleepNanos = 50 * 1000;
+
+struct Lateness
+{
+  PosixThread::LatencyHistogram latency;
+  bool configured;
+  char pad_[POSIX_CACHELINE_SIZE];
+};
+
+enum SleepMethod
+{
+  kNanosleep,
+  kNanosleepSlack,
+  kSleepUntil,
+};
+
+template <SleepMethod method>
+void sleepJitter(int threads, int64_t durationNs, BenchResult *result)
+{
+  std::vector<std::unique_ptr<Lateness>> lateness;
+  for (int t = 0; t < threads; ++t)
+  {
+    lateness.emplace_back(new Lateness());
+    lateness.back()->configured = false;
+  }
+
+  runLoop(threads, durationNs, 1, [&](int thread) {
+    Lateness &mine = *lateness[thread];
+    if (method == kNanosleepSlack && !mine.configured)
+    {
+      PosixThread::CurrentThread::setTimerSlackNanos(1);
+      mine.configured = true;
+    }
+    PosixThread::Timestamp deadline = PosixThread::addNanos(PosixThread::Timestamp::now(), kSleepNanos);
+    if (method == kSleepUntil)
+    {
+      PosixThread::CurrentThread::sleepUntil(deadline);
+    }
+    else
+    {
+      struct timespec ts = {0, static_cast<long>(kSleepNanos)};
+      ::nanosleep(&ts, NULL);
+    }
+    mine.latency.record(PosixThread::nanosBetween(PosixThread::Timestamp::now(), deadline));
+    return 1;
+  }, result);
+
+  // 框架记录的是每次调用的总时间, 换成迟到时间
+  result->latency = PosixThread::LatencyHistogram();
+  for (int t = 0; t < threads; ++t)
+  {
+    result->latency.merge(lateness[t]->latency);
+  }
+}
+
+BENCHMARK("sleep_50us_jitter", "nanosleep", sleepJitter<kNanosleep>);
+BENCHMARK("sleep_50us_jitter", "nanosleep_slack", sleepJitter<kNanosleepSlack>);
+BENCHMARK("sleep_50us_jitter", "sleep_until", sleepJitter<kSleepUntil>);
+
+} // namespace
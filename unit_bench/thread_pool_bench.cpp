@@ -0,0 +1,192 @@
+#include "bench.h"
+#include <Atomic.h>
+#include <FastClock.h>
+#include <Strand.h>
+#include <TaskGroup.h>
+#include <thread_pool.h>
+#include <map>
+#include <memory>
+#include <sched.h>
+#include <vector>
+
+namespace
+{
+
+/**
+ * 任务从提交到开始执行的排队延迟: 任务开始时记录, 基准测试结束前等所有记录过的任务执行完,
+ * 再用它替换框架记录的 "每次提交的耗时"。
+ */
+class QueueDelay
+{
+public:
+  QueueDelay()
+      : cond_(mutex_),
+        pending_(0)
+  {
+  }
+
+  // 包装任务: 开始执行时记录排队时间
+  PosixThread::ThreadPool::Task wrap(const PosixThread::ThreadPool::Task &task)
+  {
+    {
+      PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex_);
+      ++pending_;
+    }
+    int64_t submitNs = PosixThread::FastClock::nowNanos();
+    return [this, submitNs, task]() {
+      int64_t delay = PosixThread::FastClock::nowNanos() - submitNs;
+      task();
+      PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex_);
+      latency_.record(delay);
+      if (--pending_ == 0)
+      {
+        cond_.SignalAll();
+      }
+    };
+  }
+
+  void waitAll()
+  {
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex_);
+    while (pending_ > 0)
+    {
+      cond_.Wait();
+    }
+  }
+
+  const PosixThread::LatencyHistogram &latency() const { return latency_; }
+
+private:
+  PosixThread::MutexLock mutex_;
+  PosixThread::Condition cond_;
+  int64_t pending_;
+  PosixThread::LatencyHistogram latency_;
+};
+
+/**
+ * 突发负载: 一个提交线程交替 50ms 安静期 (每 2ms 一个任务) 和 50ms 突发期 (每 100us 一个任务),
+ * 每个任务睡 1ms. 输出的延迟是任务的排队时间, 比较固定 2 个线程与弹性线程池 (2 ~ 16 个线程)。
+ * 线程数固定, 框架扫描更多线程数时不重复输出。
+ */
+template <bool kElastic>
+void burstyLoad(int, int64_t durationNs, BenchResult *result)
+{
+  const int64_t kPhaseNs = 50 * 1000 * 1000;
+  result->threads = 1;
+  PosixThread::ThreadPool pool(kElastic ? "ElasticPool" : "FixedPool");
+  if (kElastic)
+  {
+    pool.setElastic(16, 500, 0.02);
+  }
+  pool.start(2);
+
+  QueueDelay delay;
+  int64_t start = PosixThread::FastClock::nowNanos();
+  runLoop(1, durationNs, 1, [&](int) {
+    bool burst = (PosixThread::FastClock::nowNanos() - start) / kPhaseNs % 2 == 1;
+    pool.run(delay.wrap([]() { PosixThread::CurrentThread::sleepUsec(1000); }));
+    PosixThread::CurrentThread::sleepUsec(burst ? 100 : 2000);
+    return 1;
+  }, result);
+  delay.waitAll();
+  pool.stop();
+  result->latency = delay.latency();
+}
+
+BENCHMARK("thread_pool_bursty_load", "fixed", burstyLoad<false>);
+BENCHMARK("thread_pool_bursty_load", "elastic", burstyLoad<true>);
+
+/**
+ * 混合负载: 4 个工作线程, 队列中始终保持 64 个 500us 的后台任务, 同时每 1ms 提交一个 50us 的交互任务。
+ * 输出交互任务的排队延迟, 比较单 FIFO 队列和 {16, 1} 两个优先级通道。
+ */
+template <bool kPriority>
+void mixedLoad(int, int64_t durationNs, BenchResult *result)
+{
+  const size_t kBacklog = 64;
+  const int interactive = 0;
+  const int bulk = kPriority ? 1 : 0;
+  result->threads = 1;
+  PosixThread::ThreadPool pool(kPriority ? "LanePool" : "FifoPool");
+  if (kPriority)
+  {
+    pool.setPriorityWeights({16, 1});
+  }
+  pool.start(4);
+
+  QueueDelay delay;
+  runLoop(1, durationNs, 1, [&](int) {
+    while (pool.queueSize() < kBacklog)
+    {
+      pool.run([]() { PosixThread::CurrentThread::sleepUsec(500); }, bulk);
+    }
+    pool.run(delay.wrap([]() { PosixThread::CurrentThread::sleepUsec(50); }), interactive);
+    PosixThread::CurrentThread::sleepUsec(1000);
+    return 1;
+  }, result);
+  delay.waitAll();
+  pool.stop();
+  result->latency = delay.latency();
+}
+
+BENCHMARK("thread_pool_mixed_load", "fifo", mixedLoad<false>);
+BENCHMARK("thread_pool_mixed_load", "priority", mixedLoad<true>);
+
+/**
+ * 热点对象: 所有线程更新同一个 std::map 计数器。
+ *  mutex  : 每次更新加 MutexLock, 在调用线程执行
+ *  strand : post 到 strand, 由同样线程数的线程池执行; 在途的任务最多 kMaxInFlight 个, 超过时调用者等待
+ * 一次更新计一次操作。
+ */
+const int64_t kMaxInFlight = 4096;
+
+void hotObjectMutex(int threads, int64_t durationNs, BenchResult *result)
+{
+  std::map<int, int64_t> counts;
+  PosixThread::MutexLock mutex;
+  runLoop(threads, durationNs, 16, [&](int thread) {
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex);
+    counts[thread % 64] += 1;
+    return 1;
+  }, result);
+}
+
+void hotObjectStrand(int threads, int64_t durationNs, BenchResult *result)
+{
+  std::map<int, int64_t> counts; // 只在 strand 中访问
+  int64_t posted = 0;
+  int64_t executed = 0;
+  PosixThread::ThreadPool pool("StrandBenchPool");
+  pool.start(threads);
+  {
+    PosixThread::Strand strand(&pool);
+    runLoop(threads, durationNs, 16, [&](int thread) {
+      if (PosixThread::detail::atomicLoad(&posted, __ATOMIC_RELAXED) -
+              PosixThread::detail::atomicLoad(&executed, __ATOMIC_RELAXED) >= kMaxInFlight)
+      {
+        ::sched_yield();
+        return 0;
+      }
+      PosixThread::detail::atomicFetchAdd(&posted, static_cast<int64_t>(1), __ATOMIC_RELAXED);
+      strand.post([&counts, &executed, thread]() {
+        counts[thread % 64] += 1;
+        PosixThread::detail::atomicFetchAdd(&executed, static_cast<int64_t>(1), __ATOMIC_RELAXED);
+      });
+      return 1;
+    }, result);
+  } // ~Strand 等待所有任务执行完
+  pool.stop();
+}
+
+BENCHMARK("hot_object_update", "mutex", hotObjectMutex);
+BENCHMARK("hot_object_update", "strand", hotObjectStrand);
+
+// CancellationToken::isCancelled() 的开销: 所有线程在热循环中轮询同一个取消标志
+BENCHMARK("cancellation_poll", "posix", [](int threads, int64_t durationNs, BenchResult *result) {
+  PosixThread::CancellationToken token;
+  runLoop(threads, durationNs, 1024, [&](int) {
+    return token.isCancelled() ? 0 : 1;
+  }, result);
+});
+
+} // namespace
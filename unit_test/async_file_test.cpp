@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <AsyncFile.h>
+#include <CountDownLatch.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int openTempFile(const std::string &dir, std::string *path)
+{
+  std::string pattern = dir + "/async_file_test.XXXXXX";
+  std::vector<char> buf(pattern.begin(), pattern.end());
+  buf.push_back('\0');
+  int fd = ::mkstemp(buf.data());
+  if (fd >= 0)
+  {
+    *path = buf.data();
+  }
+  return fd;
+}
+
+static void readWriteRoundTrip(PosixThread::AsyncFile::Backend backend)
+{
+  std::string path;
+  int fd = openTempFile("/tmp", &path);
+  ASSERT_GE(fd, 0);
+
+  const size_t kBlock = 4096;
+  const int kBlocks = 16;
+  void *memory = NULL;
+  ASSERT_EQ(0, ::posix_memalign(&memory, kBlock, kBlock * kBlocks * 2));
+  char *out = static_cast<char *>(memory);
+  char *in = out + kBlock * kBlocks;
+  for (size_t i = 0; i < kBlock * kBlocks; ++i)
+  {
+    out[i] = static_cast<char>('a' + i % 26);
+  }
+  memset(in, 0, kBlock * kBlocks);
+
+  {
+    PosixThread::AsyncFile file(8, backend);
+    if (file.backend() == PosixThread::AsyncFile::kIoUring)
+    {
+      struct iovec iov;
+      iov.iov_base = memory;
+      iov.iov_len = kBlock * kBlocks * 2;
+      // RLIMIT_MEMLOCK 太小时注册缓冲区会失败, 不影响正确性
+      file.registerBuffers(std::vector<struct iovec>(1, iov));
+      ASSERT_TRUE(file.registerFiles(std::vector<int>(1, fd)));
+    }
+
+    std::vector<std::future<ssize_t>> writes;
+    for (int i = 0; i < kBlocks; ++i)
+    {
+      writes.push_back(file.write(fd, out + i * kBlock, kBlock, i * kBlock));
+    }
+    for (int i = 0; i < kBlocks; ++i)
+    {
+      ASSERT_EQ(static_cast<ssize_t>(kBlock), writes[i].get());
+    }
+    ASSERT_EQ(0, file.fsync(fd, true).get());
+
+    PosixThread::CountDownLatch latch(kBlocks);
+    for (int i = 0; i < kBlocks; ++i)
+    {
+      file.read(fd, in + i * kBlock, kBlock, i * kBlock, [&](ssize_t result) {
+        EXPECT_EQ(static_cast<ssize_t>(kBlock), result);
+        latch.CountDown();
+      });
+    }
+    latch.Wait();
+    ASSERT_EQ(0, memcmp(out, in, kBlock * kBlocks));
+
+    // 错误以 -errno 返回
+    int badFd = ::open(path.c_str(), O_WRONLY);
+    ASSERT_EQ(-EBADF, file.read(badFd, in, kBlock, 0).get());
+    ::close(badFd);
+
+    PosixThread::AsyncFileStats stats = file.stats();
+    ASSERT_EQ(stats.submitted, stats.completed);
+  }
+
+  ::free(memory);
+  ::close(fd);
+  ::unlink(path.c_str());
+}
+
+TEST(AsyncFileTest, IoUringRoundTrip)
+{
+  readWriteRoundTrip(PosixThread::AsyncFile::kAuto);
+}
+
+TEST(AsyncFileTest, ThreadPoolRoundTrip)
+{
+  readWriteRoundTrip(PosixThread::AsyncFile::kThreadPool);
+}
+
+TEST(AsyncFileTest, BatchedSubmit)
+{
+  std::string path;
+  int fd = openTempFile("/tmp", &path);
+  ASSERT_GE(fd, 0);
+
+  const int kWrites = 64;
+  const int kBatch = 8;
+  char block[512];
+  memset(block, 'x', sizeof block);
+
+  PosixThread::AsyncFile file(kWrites);
+  file.setSubmitBatch(kBatch);
+  PosixThread::CountDownLatch latch(kWrites);
+  for (int i = 0; i < kWrites; ++i)
+  {
+    file.write(fd, block, sizeof block, i * sizeof block, [&](ssize_t result) {
+      EXPECT_EQ(static_cast<ssize_t>(sizeof block), result);
+      latch.CountDown();
+    });
+  }
+  file.flush();
+  latch.Wait();
+
+  PosixThread::AsyncFileStats stats = file.stats();
+  ASSERT_EQ(static_cast<uint64_t>(kWrites), stats.completed);
+  if (file.backend() == PosixThread::AsyncFile::kIoUring)
+  {
+    ASSERT_LE(stats.enterCalls, static_cast<uint64_t>(kWrites / kBatch));
+  }
+
+  ::close(fd);
+  ::unlink(path.c_str());
+}
+
+// 队列深度为 1, 每个回调再提交两个请求: 回调中提交时队列总是满的, 不能阻塞执行回调的线程
+static void submitFromCallback(PosixThread::AsyncFile::Backend backend)
+{
+  std::string path;
+  int fd = openTempFile("/tmp", &path);
+  ASSERT_GE(fd, 0);
+
+  const int kWrites = 63; // 1 + 2 + 4 + 8 + 16 + 32
+  char block[512];
+  memset(block, 'y', sizeof block);
+  {
+    PosixThread::AsyncFile file(1, backend);
+    PosixThread::CountDownLatch latch(kWrites);
+    PosixThread::AtomicInt32 next;
+    std::function<void(ssize_t)> onWritten = [&](ssize_t result) {
+      EXPECT_EQ(static_cast<ssize_t>(sizeof block), result);
+      for (int i = 0; i < 2; ++i)
+      {
+        int index = next.incrementAndGet();
+        if (index < kWrites)
+        {
+          file.write(fd, block, sizeof block, index * sizeof block, onWritten);
+        }
+      }
+      latch.CountDown();
+    };
+    file.write(fd, block, sizeof block, 0, onWritten);
+    latch.Wait();
+
+    PosixThread::AsyncFileStats stats = file.stats();
+    ASSERT_EQ(static_cast<uint64_t>(kWrites), stats.submitted);
+  }
+  struct stat st;
+  ASSERT_EQ(0, ::fstat(fd, &st));
+  ASSERT_EQ(static_cast<off_t>(kWrites * sizeof block), st.st_size);
+
+  ::close(fd);
+  ::unlink(path.c_str());
+}
+
+TEST(AsyncFileTest, SubmitFromCallbackIoUring)
+{
+  submitFromCallback(PosixThread::AsyncFile::kAuto);
+}
+
+TEST(AsyncFileTest, SubmitFromCallbackThreadPool)
+{
+  submitFromCallback(PosixThread::AsyncFile::kThreadPool);
+}
+
+// 析构函数在第一个回调执行期间开始: 要等回调返回, 回调中提交的请求也要完成并执行回调
+static void destroyDuringCallback(PosixThread::AsyncFile::Backend backend)
+{
+  std::string path;
+  int fd = openTempFile("/tmp", &path);
+  ASSERT_GE(fd, 0);
+
+  char block[512];
+  memset(block, 'z', sizeof block);
+  PosixThread::CountDownLatch started(1);
+  bool chainedDone = false;
+  {
+    PosixThread::AsyncFile file(4, backend);
+    file.write(fd, block, sizeof block, 0, [&](ssize_t result) {
+      EXPECT_EQ(static_cast<ssize_t>(sizeof block), result);
+      started.CountDown();
+      // 让析构函数先开始等待
+      ::usleep(50 * 1000);
+      file.write(fd, block, sizeof block, sizeof block, [&](ssize_t chained) {
+        EXPECT_EQ(static_cast<ssize_t>(sizeof block), chained);
+        chainedDone = true;
+      });
+    });
+    started.Wait();
+  }
+  ASSERT_TRUE(chainedDone);
+
+  ::close(fd);
+  ::unlink(path.c_str());
+}
+
+TEST(AsyncFileTest, DestroyDuringCallbackIoUring)
+{
+  destroyDuringCallback(PosixThread::AsyncFile::kAuto);
+}
+
+TEST(AsyncFileTest, DestroyDuringCallbackThreadPool)
+{
+  destroyDuringCallback(PosixThread::AsyncFile::kThreadPool);
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <ConcurrentHashMap.h>
+#include <posix_thread.h>
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+
+TEST(ConcurrentHashMapTest, Basic)
+{
+  PosixThread::ConcurrentHashMap<int, int> map(4, 4);
+  ASSERT_EQ(map.shardCount(), 4u);
+
+  const int kKeys = 10000;
+  for (int i = 0; i < kKeys; ++i)
+  {
+    ASSERT_TRUE(map.insert(i, i * 2));
+  }
+  ASSERT_FALSE(map.insert(1, 100));
+  ASSERT_EQ(map.size(), static_cast<size_t>(kKeys));
+
+  for (int i = 0; i < kKeys; ++i)
+  {
+    int value = -1;
+    ASSERT_TRUE(map.find(i, &value));
+    ASSERT_EQ(value, i * 2);
+  }
+  ASSERT_FALSE(map.contains(kKeys));
+
+  for (int i = 0; i < kKeys; i += 2)
+  {
+    ASSERT_TRUE(map.erase(i));
+  }
+  ASSERT_FALSE(map.erase(0));
+  ASSERT_EQ(map.size(), static_cast<size_t>(kKeys / 2));
+  ASSERT_FALSE(map.contains(0));
+  ASSERT_TRUE(map.contains(1));
+
+  map.upsert(1, 7);
+  map.upsert(1, 0, [](int &value) { value += 1; });
+  map.upsert(0, 42, [](int &value) { value += 1; });
+  int value = 0;
+  ASSERT_TRUE(map.find(1, &value));
+  ASSERT_EQ(value, 8);
+  ASSERT_TRUE(map.find(0, &value));
+  ASSERT_EQ(value, 42);
+
+  int computed = 0;
+  ASSERT_EQ(map.computeIfAbsent(3, [&computed]() { return ++computed; }), 6);
+  ASSERT_EQ(map.computeIfAbsent(kKeys + 1, [&computed]() { return ++computed; }), 1);
+  ASSERT_EQ(map.computeIfAbsent(kKeys + 1, [&computed]() { return ++computed; }), 1);
+  ASSERT_EQ(computed, 1);
+}
+
+TEST(ConcurrentHashMapTest, StringKeysUseLockedReads)
+{
+  PosixThread::ConcurrentHashMap<std::string, std::string> map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.upsert(std::to_string(i), "value" + std::to_string(i));
+  }
+  std::string value;
+  ASSERT_TRUE(map.find("999", &value));
+  ASSERT_EQ(value, "value999");
+  ASSERT_TRUE(map.erase("999"));
+  ASSERT_FALSE(map.find("999", &value));
+}
+
+// 写者不断插入触发渐进扩容, 读者乐观读, 已经插入的键必须始终能读到正确的值
+TEST(ConcurrentHashMapTest, ReadersDuringResize)
+{
+  PosixThread::ConcurrentHashMap<int64_t, int64_t> map(2, 4);
+  const int64_t kKeys = 200000;
+  int64_t published = 0;
+  PosixThread::AtomicInt32 errors;
+
+  std::vector<std::unique_ptr<PosixThread::Thread>> readers;
+  for (int r = 0; r < 2; ++r)
+  {
+    readers.emplace_back(new PosixThread::Thread([&]() {
+      int64_t seed = 12345;
+      for (;;)
+      {
+        int64_t limit = PosixThread::detail::atomicLoad(&published, __ATOMIC_ACQUIRE);
+        if (limit == kKeys)
+        {
+          break;
+        }
+        if (limit == 0)
+        {
+          continue;
+        }
+        seed = seed * 6364136223846793005LL + 1442695040888963407LL;
+        int64_t key = static_cast<int64_t>(static_cast<uint64_t>(seed) % static_cast<uint64_t>(limit));
+        int64_t value = 0;
+        if (!map.find(key, &value) || value != key * 3)
+        {
+          errors.increment();
+        }
+      }
+    }));
+    readers.back()->start();
+  }
+
+  for (int64_t i = 0; i < kKeys; ++i)
+  {
+    map.insert(i, i * 3);
+    PosixThread::detail::atomicStore(&published, i + 1, __ATOMIC_RELEASE);
+  }
+  for (size_t r = 0; r < readers.size(); ++r)
+  {
+    readers[r]->join();
+  }
+  ASSERT_EQ(errors.get(), 0);
+  ASSERT_EQ(map.size(), static_cast<size_t>(kKeys));
+}
+
+static int64_t residentBytes()
+{
+  long pages = 0;
+  long resident = 0;
+  FILE *fp = ::fopen("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    ::fclose(fp);
+  }
+  return static_cast<int64_t>(resident) * ::sysconf(_SC_PAGESIZE);
+}
+
+// 反复插入/删除, 表中始终只有很少的元素: 墓碑触发的重建是原地进行的, 内存不随轮数增长
+TEST(ConcurrentHashMapTest, ChurnDoesNotGrowMemory)
+{
+  PosixThread::ConcurrentHashMap<int64_t, int64_t> map(1, 16);
+  const int kRounds = 6;
+  const int64_t kChurn = 1000000;
+  int64_t next = 0;
+  int64_t afterFirstRound = 0;
+  for (int round = 0; round < kRounds; ++round)
+  {
+    for (int64_t i = 0; i < kChurn; ++i, ++next)
+    {
+      ASSERT_TRUE(map.insert(next, next));
+      ASSERT_TRUE(map.erase(next));
+    }
+    if (round == 0)
+    {
+      afterFirstRound = residentBytes();
+    }
+  }
+  ASSERT_EQ(map.size(), 0u);
+  // 修复前每轮都会退役数万张小表, 每轮增长几十 MB
+  ASSERT_LT(residentBytes() - afterFirstRound, 4 * 1024 * 1024);
+}
+
+// 写者交替插入/删除一批临时键 (反复触发原地重建和扩容), 常驻键在乐观读者看来必须始终存在且值正确,
+// 临时键要么读不到, 要么读到正确的值
+TEST(ConcurrentHashMapTest, ReadersDuringEraseAndRebuild)
+{
+  PosixThread::ConcurrentHashMap<int64_t, int64_t> map(2, 8);
+  const int64_t kStable = 64;
+  const int64_t kTransientBase = 1 << 20;
+  for (int64_t i = 0; i < kStable; ++i)
+  {
+    map.insert(i, i * 7);
+  }
+  int stop = 0;
+  PosixThread::AtomicInt32 errors;
+  PosixThread::AtomicInt64 reads;
+
+  std::vector<std::unique_ptr<PosixThread::Thread>> readers;
+  for (int r = 0; r < 2; ++r)
+  {
+    readers.emplace_back(new PosixThread::Thread([&, r]() {
+      uint64_t seed = 88172645463325252ULL + r;
+      int64_t local = 0;
+      while (!PosixThread::detail::atomicLoad(&stop, __ATOMIC_ACQUIRE))
+      {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        int64_t value = -1;
+        int64_t key = static_cast<int64_t>(seed % kStable);
+        if (!map.find(key, &value) || value != key * 7)
+        {
+          errors.increment();
+        }
+        key = kTransientBase + static_cast<int64_t>(seed % 4096);
+        if (map.find(key, &value) && value != key * 7)
+        {
+          errors.increment();
+        }
+        ++local;
+      }
+      reads.getAndAdd(local);
+    }));
+    readers.back()->start();
+  }
+
+  for (int round = 0; round < 200; ++round)
+  {
+    for (int64_t i = 0; i < 4096; ++i)
+    {
+      map.insert(kTransientBase + i, (kTransientBase + i) * 7);
+    }
+    for (int64_t i = 0; i < 4096; ++i)
+    {
+      map.erase(kTransientBase + i);
+    }
+  }
+  PosixThread::detail::atomicStore(&stop, 1, __ATOMIC_RELEASE);
+  for (size_t r = 0; r < readers.size(); ++r)
+  {
+    readers[r]->join();
+  }
+  ASSERT_EQ(errors.get(), 0);
+  ASSERT_GT(reads.get(), 0);
+  ASSERT_EQ(map.size(), static_cast<size_t>(kStable));
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "test_util.h"
+#include <EventCount.h>
+#include <ParkingLot.h>
+#include <posix_thread.h>
+
+TEST(EventCountTest, ProducerConsumer)
+{
+  const int64_t kItems = 100000;
+  PosixThread::EventCount ec;
+  int64_t produced = 0;
+  int64_t consumed = 0;
+
+  PosixThread::Thread consumer([&]() {
+    while (consumed < kItems)
+    {
+      int64_t available = 0;
+      ec.await([&]() {
+        available = PosixThread::detail::atomicLoad(&produced, __ATOMIC_ACQUIRE);
+        return available > consumed;
+      });
+      consumed = available;
+    }
+  }, "EventCountConsumer");
+  consumer.start();
+
+  for (int64_t i = 1; i <= kItems; ++i)
+  {
+    PosixThread::detail::atomicStore(&produced, i, __ATOMIC_RELEASE);
+    ec.notify();
+  }
+  consumer.join();
+  ASSERT_EQ(consumed, kItems);
+}
+
+TEST(EventCountTest, NotifyAllWakesEveryWaiter)
+{
+  const int kWaiters = 4;
+  PosixThread::EventCount ec;
+  int go = 0;
+  PosixThread::AtomicInt32 woken;
+  std::vector<std::unique_ptr<PosixThread::Thread>> threads;
+  for (int i = 0; i < kWaiters; ++i)
+  {
+    threads.emplace_back(new PosixThread::Thread([&]() {
+      ec.await([&]() { return PosixThread::detail::atomicLoad(&go) != 0; });
+      woken.increment();
+    }));
+    threads.back()->start();
+  }
+
+  PosixThread::CurrentThread::sleepUsec(10 * 1000);
+  PosixThread::detail::atomicStore(&go, 1);
+  ec.notifyAll();
+  for (int i = 0; i < kWaiters; ++i)
+  {
+    threads[i]->join();
+  }
+  ASSERT_EQ(woken.get(), kWaiters);
+}
+
+TEST(ParkingLotTest, ParkAndUnpark)
+{
+  uint32_t flag = 0;
+
+  // validate 返回 false 时不睡眠
+  ASSERT_EQ(PosixThread::ParkingLot::park(&flag, []() { return false; }), PosixThread::ParkingLot::kSkipped);
+  ASSERT_EQ(PosixThread::ParkingLot::park(&flag, []() { return true; }, 1000), PosixThread::ParkingLot::kTimedOut);
+  // 超时按一次算出的截止时间计算, 不会因为中途醒来而重新计时
+  int64_t start = nowNanos();
+  ASSERT_EQ(PosixThread::ParkingLot::park(&flag, []() { return true; }, 20 * 1000), PosixThread::ParkingLot::kTimedOut);
+  int64_t elapsed = nowNanos() - start;
+  ASSERT_GE(elapsed, 20 * 1000 * 1000);
+  ASSERT_LT(elapsed, 500 * 1000 * 1000);
+  ASSERT_EQ(PosixThread::ParkingLot::unparkAll(&flag), 0);
+
+  const int kWaiters = 3;
+  std::vector<std::unique_ptr<PosixThread::Thread>> threads;
+  for (int i = 0; i < kWaiters; ++i)
+  {
+    threads.emplace_back(new PosixThread::Thread([&flag]() {
+      PosixThread::ParkingLot::waitWhileEqual(&flag, static_cast<uint32_t>(0));
+    }));
+    threads.back()->start();
+  }
+
+  PosixThread::CurrentThread::sleepUsec(10 * 1000);
+  PosixThread::detail::atomicStore(&flag, static_cast<uint32_t>(1));
+  PosixThread::ParkingLot::unparkAll(&flag);
+  for (int i = 0; i < kWaiters; ++i)
+  {
+    threads[i]->join();
+  }
+}
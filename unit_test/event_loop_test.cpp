@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <Channel.h>
+#include <CountDownLatch.h>
+#include <EventLoop.h>
+#include <EventLoopThread.h>
+#include <EventLoopThreadPool.h>
+#include <posix_thread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void setNonBlock(int fd)
+{
+  int flags = ::fcntl(fd, F_GETFL, 0);
+  ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+TEST(EventLoopTest, RunInLoopThread)
+{
+  PosixThread::EventLoopThread loopThread(PosixThread::EventLoopThread::ThreadInitCallback(), "LoopThread");
+  PosixThread::EventLoop *loop = loopThread.startLoop();
+  ASSERT_FALSE(loop->isInLoopThread());
+  ASSERT_TRUE(PosixThread::EventLoop::getEventLoopOfCurrentThread() == NULL);
+
+  PosixThread::CountDownLatch latch(1);
+  int loopTid = 0;
+  loop->runInLoop([&]() {
+    loopTid = PosixThread::CurrentThread::tid();
+    // 在 loop 线程中 runInLoop 立即执行
+    loop->runInLoop([&]() { latch.CountDown(); });
+  });
+  latch.Wait();
+  ASSERT_NE(loopTid, PosixThread::CurrentThread::tid());
+}
+
+TEST(EventLoopTest, EdgeTriggeredEcho)
+{
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds));
+  setNonBlock(fds[0]);
+  setNonBlock(fds[1]);
+
+  const std::string message(16 * 1024, 'x');
+  std::string received;
+  PosixThread::CountDownLatch done(1);
+
+  PosixThread::EventLoopThread loopThread(PosixThread::EventLoopThread::ThreadInitCallback(), "EchoLoop");
+  PosixThread::EventLoop *loop = loopThread.startLoop();
+
+  // 服务端在 loop 线程中把读到的数据原样写回, 边沿触发所以每次都要读到 EAGAIN
+  PosixThread::Channel server(loop, fds[1]);
+  server.setReadCallback([&]() {
+    char buf[4096];
+    for (;;)
+    {
+      ssize_t n = ::read(fds[1], buf, sizeof buf);
+      if (n > 0)
+      {
+        ssize_t written = 0;
+        while (written < n)
+        {
+          ssize_t w = ::write(fds[1], buf + written, n - written);
+          if (w > 0)
+          {
+            written += w;
+          }
+        }
+      }
+      else
+      {
+        break;
+      }
+    }
+  });
+
+  PosixThread::Channel client(loop, fds[0]);
+  client.setReadCallback([&]() {
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fds[0], buf, sizeof buf)) > 0)
+    {
+      received.append(buf, n);
+    }
+    if (received.size() == message.size())
+    {
+      done.CountDown();
+    }
+  });
+
+  loop->runInLoop([&]() {
+    server.enableReading();
+    client.enableReading();
+    ::write(fds[0], message.data(), message.size() / 2);
+  });
+  loop->runInLoop([&]() {
+    ::write(fds[0], message.data() + message.size() / 2, message.size() / 2);
+  });
+  done.Wait();
+  ASSERT_EQ(message, received);
+
+  PosixThread::CountDownLatch removed(1);
+  loop->runInLoop([&]() {
+    server.disableAll();
+    server.remove();
+    client.disableAll();
+    client.remove();
+    removed.CountDown();
+  });
+  removed.Wait();
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(EventLoopTest, ThreadPoolRoundRobin)
+{
+  PosixThread::EventLoop baseLoop;
+  PosixThread::EventLoopThreadPool pool(&baseLoop, "LoopPool");
+  pool.setThreadNum(3);
+  pool.start();
+
+  std::vector<PosixThread::EventLoop *> loops = pool.getAllLoops();
+  ASSERT_EQ(3u, loops.size());
+  for (size_t i = 0; i < 6; ++i)
+  {
+    ASSERT_EQ(loops[i % 3], pool.getNextLoop());
+  }
+  ASSERT_EQ(pool.getLoopForHash(7), pool.getLoopForHash(7));
+
+  PosixThread::EventLoopThreadPool single(&baseLoop, "SinglePool");
+  single.start();
+  ASSERT_EQ(&baseLoop, single.getNextLoop());
+}
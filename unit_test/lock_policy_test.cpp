@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <ConcurrentHashMap.h>
+#include <CountDownLatch.h>
+#include <LockPolicy.h>
+#include <posix_thread.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// 多个线程在同一把锁下做非原子的自增, 计数不丢就说明互斥成立
+template <typename Mutex>
+static void checkMutualExclusion()
+{
+  const int kThreads = 4;
+  const int kIterations = 100000;
+  Mutex mutex;
+  int64_t counter = 0;
+  std::vector<std::unique_ptr<PosixThread::Thread>> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back(new PosixThread::Thread([&]() {
+      for (int i = 0; i < kIterations; ++i)
+      {
+        PosixThread::MutexLockGuard<Mutex> lock(mutex);
+        ++counter;
+      }
+    }, "LockPolicy"));
+    threads.back()->start();
+  }
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads[t]->join();
+  }
+  ASSERT_EQ(static_cast<int64_t>(kThreads) * kIterations, counter);
+}
+
+TEST(LockPolicyTest, MutualExclusion)
+{
+  checkMutualExclusion<PosixThread::SpinLock>();
+  checkMutualExclusion<PosixThread::FastMutex>();
+  checkMutualExclusion<PosixThread::MutexLock>();
+
+  PosixThread::FastMutex mutex;
+  ASSERT_TRUE(mutex.tryLock());
+  ASSERT_FALSE(mutex.tryLock());
+  mutex.unlock();
+  PosixThread::SpinLock spin;
+  ASSERT_TRUE(spin.tryLock());
+  ASSERT_FALSE(spin.tryLock());
+  spin.unlock();
+
+  ASSERT_TRUE(std::is_empty<PosixThread::NullMutex>::value);
+  ASSERT_EQ(sizeof(uint32_t), sizeof(PosixThread::FastMutex));
+}
+
+template <typename Mutex>
+static void checkLatch()
+{
+  const int kThreads = 4;
+  PosixThread::BasicCountDownLatch<Mutex> start(1);
+  PosixThread::BasicCountDownLatch<Mutex> done(kThreads);
+  std::vector<std::unique_ptr<PosixThread::Thread>> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back(new PosixThread::Thread([&]() {
+      start.Wait();
+      done.CountDown();
+    }, "LatchPolicy"));
+    threads.back()->start();
+  }
+  ::usleep(10 * 1000);
+  ASSERT_EQ(kThreads, done.GetCount());
+  start.CountDown();
+  done.Wait();
+  ASSERT_EQ(0, done.GetCount());
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads[t]->join();
+  }
+}
+
+TEST(LockPolicyTest, LatchWithEachPolicy)
+{
+  checkLatch<PosixThread::SpinLock>();
+  checkLatch<PosixThread::FastMutex>();
+  checkLatch<PosixThread::MutexLock>();
+
+  // 单线程: 计数归零之后 Wait() 直接返回
+  PosixThread::BasicCountDownLatch<PosixThread::NullMutex> latch(2);
+  latch.CountDown();
+  ASSERT_EQ(1, latch.GetCount());
+  latch.CountDown();
+  latch.Wait();
+  ASSERT_EQ(0, latch.GetCount());
+}
+
+TEST(LockPolicyTest, FutexConditionTimedWait)
+{
+  PosixThread::FastMutex mutex;
+  PosixThread::FutexCondition<PosixThread::FastMutex> cond(mutex);
+  PosixThread::MutexLockGuard<PosixThread::FastMutex> lock(mutex);
+  int64_t start = PosixThread::FastClock::monotonicNanos();
+  ASSERT_TRUE(cond.WaitForSeconds(0.02));
+  ASSERT_GE(PosixThread::FastClock::monotonicNanos() - start, 19 * 1000 * 1000);
+}
+
+TEST(LockPolicyTest, HashMapWithNullMutex)
+{
+  PosixThread::ConcurrentHashMap<int, int, std::hash<int>, std::equal_to<int>, PosixThread::NullMutex> map(1, 4);
+  for (int i = 0; i < 1000; ++i)
+  {
+    ASSERT_TRUE(map.insert(i, i + 1));
+  }
+  for (int i = 0; i < 1000; i += 2)
+  {
+    ASSERT_TRUE(map.erase(i));
+  }
+  int value = 0;
+  ASSERT_TRUE(map.find(999, &value));
+  ASSERT_EQ(1000, value);
+  ASSERT_FALSE(map.contains(0));
+  ASSERT_EQ(500u, map.size());
+}
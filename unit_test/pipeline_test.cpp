@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "test_util.h"
+#include <Atomic.h>
+#include <Pipeline.h>
+#include <set>
+#include <string>
+
+// 让并行阶段的耗时随序号变化, 数据项会乱序到达后面的串行阶段
+static void spin(int64_t ns)
+{
+  int64_t end = nowNanos() + ns;
+  while (nowNanos() < end)
+  {
+  }
+}
+
+struct Item
+{
+  int64_t seq;
+  int64_t value;
+  std::string buffer;
+};
+
+TEST(PipelineTest, InOrderWithBoundedTokens)
+{
+  const int64_t kItems = 2000;
+  const size_t kTokens = 8;
+
+  int64_t produced = 0;
+  int inFlight = 0;
+  int maxInFlight = 0;
+  std::set<const Item *> objects;
+  std::vector<int64_t> output;
+  bool serial = true;
+  int writers = 0;
+
+  PosixThread::Pipeline<Item> pipeline("PipeTest");
+  pipeline.source([&](Item &item) {
+            if (produced == kItems)
+            {
+              return false;
+            }
+            objects.insert(&item);
+            item.seq = produced++;
+            item.buffer.assign(64, 'x');
+            int now = PosixThread::detail::atomicFetchAdd(&inFlight, 1) + 1;
+            maxInFlight = now > maxInFlight ? now : maxInFlight;
+            return true;
+          })
+      .stage("square", PosixThread::Pipeline<Item>::kParallel, [&](Item &item) {
+        spin((item.seq % 7) * 2000);
+        item.value = item.seq * item.seq;
+      })
+      .stage("write", PosixThread::Pipeline<Item>::kSerialInOrder, [&](Item &item) {
+        serial = serial && PosixThread::detail::atomicFetchAdd(&writers, 1) == 0;
+        ASSERT_EQ(item.seq * item.seq, item.value);
+        output.push_back(item.seq);
+        PosixThread::detail::atomicFetchAdd(&writers, -1);
+        PosixThread::detail::atomicFetchAdd(&inFlight, -1);
+      });
+  pipeline.run(4, kTokens);
+
+  ASSERT_TRUE(serial);
+  ASSERT_EQ(static_cast<size_t>(kItems), output.size());
+  for (int64_t i = 0; i < kItems; ++i)
+  {
+    ASSERT_EQ(i, output[i]);
+  }
+  ASSERT_LE(maxInFlight, static_cast<int>(kTokens));
+  // 数据项对象被回收复用, 总共只有 kTokens 个
+  ASSERT_LE(objects.size(), kTokens);
+
+  PosixThread::PipelineStats stats = pipeline.stats();
+  ASSERT_EQ(3u, stats.stages.size());
+  ASSERT_EQ(static_cast<uint64_t>(kItems), stats.stages[0].items);
+  ASSERT_EQ(static_cast<uint64_t>(kItems), stats.stages[1].items);
+  ASSERT_EQ(static_cast<uint64_t>(kItems), stats.stages[2].items);
+  ASSERT_LE(stats.maxInFlight, kTokens);
+
+  // 同一个 Pipeline 可以再次运行
+  produced = kItems - 10;
+  output.clear();
+  pipeline.run(2, 4);
+  ASSERT_EQ(10u, output.size());
+  ASSERT_EQ(10u, pipeline.stats().stages[2].items);
+}
+
+TEST(PipelineTest, SerialOutOfOrder)
+{
+  const int64_t kItems = 5000;
+
+  int64_t produced = 0;
+  int64_t sum = 0;
+  int running = 0;
+  bool serial = true;
+
+  PosixThread::Pipeline<Item> pipeline("PipeTest");
+  pipeline.source([&](Item &item) {
+            item.seq = produced;
+            return produced++ < kItems;
+          })
+      .stage("work", PosixThread::Pipeline<Item>::kParallel, [&](Item &item) { spin((item.seq % 3) * 1000); })
+      .stage("sum", PosixThread::Pipeline<Item>::kSerialOutOfOrder, [&](Item &item) {
+        serial = serial && PosixThread::detail::atomicFetchAdd(&running, 1) == 0;
+        sum += item.seq;
+        PosixThread::detail::atomicFetchAdd(&running, -1);
+      });
+  pipeline.run(3, 6);
+
+  ASSERT_TRUE(serial);
+  ASSERT_EQ(kItems * (kItems - 1) / 2, sum);
+}
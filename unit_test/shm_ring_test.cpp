@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <ShmRing.h>
+#include <posix_thread.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 记录内容: 8 字节序号 + (序号 % 50) 个填充字节, 长度不等, 可以检查回绕和对齐
+struct Record
+{
+  static size_t length(uint64_t seq) { return sizeof(uint64_t) + seq % 50; }
+
+  static void fill(char *data, uint32_t producer, uint64_t seq)
+  {
+    uint64_t tagged = (static_cast<uint64_t>(producer) << 48) | seq;
+    memcpy(data, &tagged, sizeof tagged);
+    memset(data + sizeof tagged, static_cast<int>(seq & 0xff), seq % 50);
+  }
+
+  static bool check(const char *data, size_t len, uint32_t *producer, uint64_t *seq)
+  {
+    uint64_t tagged;
+    memcpy(&tagged, data, sizeof tagged);
+    *producer = static_cast<uint32_t>(tagged >> 48);
+    *seq = tagged & ((1ULL << 48) - 1);
+    if (len != length(*seq))
+    {
+      return false;
+    }
+    for (size_t i = sizeof tagged; i < len; ++i)
+    {
+      if (static_cast<unsigned char>(data[i]) != (*seq & 0xff))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+static void produce(PosixThread::ShmRing *ring, uint32_t producer, uint64_t from, uint64_t to)
+{
+  for (uint64_t seq = from; seq < to; ++seq)
+  {
+    char *data = static_cast<char *>(ring->reserve(Record::length(seq)));
+    Record::fill(data, producer, seq);
+    ring->commit(data);
+  }
+}
+
+TEST(ShmRingTest, SingleProducerThreads)
+{
+  const uint64_t kRecords = 200000;
+  std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::createAnonymous("ShmRingTest", 64 * 1024);
+  ASSERT_TRUE(segment != NULL);
+  PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kSingleProducer);
+
+  PosixThread::Thread producer([&]() { produce(&ring, 0, 0, kRecords); }, "ShmProducer");
+  producer.start();
+
+  uint64_t expected = 0;
+  bool ok = true;
+  while (expected < kRecords)
+  {
+    ring.waitForData();
+    ring.read([&](const char *data, size_t len) {
+      uint32_t id;
+      uint64_t seq;
+      ok = ok && Record::check(data, len, &id, &seq) && seq == expected;
+      ++expected;
+    });
+  }
+  producer.join();
+  ASSERT_TRUE(ok);
+  ASSERT_TRUE(ring.empty());
+}
+
+// 生产者是 fork 出来的子进程, 各自附着同一个 memfd 段, 消费者检查每个生产者内部的顺序
+TEST(ShmRingTest, MultiProducerProcesses)
+{
+  const int kProducers = 3;
+  const uint64_t kRecords = 50000;
+  std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::createAnonymous("ShmRingTest", 64 * 1024);
+  ASSERT_TRUE(segment != NULL);
+  PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kMultiProducer);
+
+  std::vector<pid_t> children;
+  for (int p = 0; p < kProducers; ++p)
+  {
+    pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+      PosixThread::ShmRing attached(segment->data(), segment->size(), PosixThread::ShmRing::kMultiProducer);
+      produce(&attached, p, 0, kRecords);
+      ::_exit(0);
+    }
+    children.push_back(pid);
+  }
+
+  std::vector<uint64_t> next(kProducers, 0);
+  uint64_t total = 0;
+  bool ok = true;
+  while (total < kProducers * kRecords)
+  {
+    if (!ring.waitForData(5 * 1000 * 1000))
+    {
+      break;
+    }
+    total += ring.read([&](const char *data, size_t len) {
+      uint32_t id;
+      uint64_t seq;
+      ok = ok && Record::check(data, len, &id, &seq) && id < kProducers && seq == next[id]++;
+    });
+  }
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    int status = 0;
+    ::waitpid(children[i], &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(kProducers * kRecords, total);
+}
+
+// 具名段: 生产者在 reserve 之后崩溃, 消费者 unblock() 跳过残留记录; 双方重新打开段之后继续
+TEST(ShmRingTest, SurvivesRestart)
+{
+  const std::string kName = "/posix_thread_shm_ring_test";
+  PosixThread::ShmSegment::unlinkNamed(kName);
+
+  pid_t pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::openNamed(kName, 64 * 1024);
+    PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kSingleProducer);
+    produce(&ring, 0, 0, 100);
+    ring.reserve(Record::length(100)); // 没有提交就退出
+    ::_exit(0);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+
+  uint64_t expected = 0;
+  bool ok = true;
+  auto consume = [&](const char *data, size_t len) {
+    uint32_t id;
+    uint64_t seq;
+    ok = ok && Record::check(data, len, &id, &seq) && seq == expected;
+    ++expected;
+  };
+  {
+    std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::openNamed(kName, 64 * 1024);
+    ASSERT_TRUE(segment != NULL);
+    PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kSingleProducer);
+    ASSERT_EQ(50u, ring.read(consume, 50));
+  }
+  // 消费者 "重启": 重新打开段, 从上次的位置继续
+  std::unique_ptr<PosixThread::ShmSegment> segment = PosixThread::ShmSegment::openNamed(kName, 64 * 1024);
+  PosixThread::ShmRing ring(segment->data(), segment->size(), PosixThread::ShmRing::kSingleProducer);
+  ASSERT_EQ(50u, ring.read(consume));
+  ASSERT_FALSE(ring.waitForData(1000));
+  ASSERT_TRUE(ring.unblock());
+  ASSERT_EQ(0u, ring.read(consume));
+
+  // 生产者重启, 从 101 开始继续写
+  pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    std::unique_ptr<PosixThread::ShmSegment> restarted = PosixThread::ShmSegment::openNamed(kName, 0);
+    PosixThread::ShmRing producer(restarted->data(), restarted->size(), PosixThread::ShmRing::kSingleProducer);
+    produce(&producer, 0, 101, 200);
+    ::_exit(0);
+  }
+  expected = 101;
+  while (expected < 200 && ring.waitForData(5 * 1000 * 1000))
+  {
+    ring.read(consume);
+  }
+  ::waitpid(pid, &status, 0);
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(200u, expected);
+  PosixThread::ShmSegment::unlinkNamed(kName);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <SpinWait.h>
+#include <Timestamp.h>
+#include <posix_thread.h>
+
+TEST(SleepTest, SpinWaitBacksOff)
+{
+  PosixThread::SpinWait spin;
+  ASSERT_FALSE(spin.nextSpinWillYield());
+  for (int i = 0; i < PosixThread::SpinWait::kSpinRounds; ++i)
+  {
+    spin.spinOnce();
+  }
+  ASSERT_TRUE(spin.nextSpinWillYield());
+
+  // 进入睡眠阶段之后每次至少睡 kMinSleepNanos
+  for (int i = 0; i < PosixThread::SpinWait::kYieldRounds; ++i)
+  {
+    spin.spinOnce();
+  }
+  int64_t start = PosixThread::FastClock::monotonicNanos();
+  spin.spinOnce();
+  ASSERT_GE(PosixThread::FastClock::monotonicNanos() - start,
+            static_cast<int64_t>(PosixThread::SpinWait::kMinSleepNanos));
+
+  // 计数有上限, 一直等下去也不会溢出, 睡眠时间不超过 kMaxSleepNanos 太多
+  for (int i = 0; i < 20; ++i)
+  {
+    spin.spinOnce();
+  }
+  start = PosixThread::FastClock::monotonicNanos();
+  spin.spinOnce();
+  ASSERT_LT(PosixThread::FastClock::monotonicNanos() - start,
+            static_cast<int64_t>(50 * PosixThread::SpinWait::kMaxSleepNanos));
+
+  spin.reset();
+  ASSERT_EQ(0, spin.count());
+}
+
+TEST(SleepTest, TimerSlack)
+{
+  int64_t original = PosixThread::CurrentThread::timerSlackNanos();
+  ASSERT_GT(original, 0);
+
+  PosixThread::Thread thread([]() {
+    ASSERT_TRUE(PosixThread::CurrentThread::setTimerSlackNanos(1000));
+    ASSERT_EQ(1000, PosixThread::CurrentThread::timerSlackNanos());
+    ASSERT_TRUE(PosixThread::CurrentThread::setTimerSlackNanos(0));
+    ASSERT_GT(PosixThread::CurrentThread::timerSlackNanos(), 0);
+  }, "TimerSlack");
+  thread.start();
+  thread.join();
+
+  // 只影响设置的线程
+  ASSERT_EQ(original, PosixThread::CurrentThread::timerSlackNanos());
+}
+
+TEST(SleepTest, SleepUntilNeverEarly)
+{
+  for (int i = 0; i < 50; ++i)
+  {
+    PosixThread::Timestamp deadline = PosixThread::addNanos(PosixThread::Timestamp::now(), 30 * 1000);
+    PosixThread::CurrentThread::sleepUntil(deadline);
+    ASSERT_GE(PosixThread::Timestamp::now(), deadline);
+  }
+
+  // 已经过去的 deadline 立即返回
+  int64_t start = PosixThread::FastClock::monotonicNanos();
+  PosixThread::CurrentThread::sleepUntil(PosixThread::addNanos(PosixThread::Timestamp::now(), -1000 * 1000));
+  ASSERT_LT(PosixThread::FastClock::monotonicNanos() - start, 1000 * 1000);
+
+  // 较长的睡眠大部分时间在内核里
+  start = PosixThread::FastClock::monotonicNanos();
+  PosixThread::CurrentThread::sleepForNanos(20 * 1000 * 1000);
+  int64_t elapsed = PosixThread::FastClock::monotonicNanos() - start;
+  ASSERT_GE(elapsed, 20 * 1000 * 1000);
+  ASSERT_LT(elapsed, 500 * 1000 * 1000);
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include <Atomic.h>
+#include <CountDownLatch.h>
+#include <Strand.h>
+#include <thread_pool.h>
+#include <stdexcept>
+
+TEST(StrandTest, SerialAndOrdered)
+{
+  const int kProducers = 4;
+  const int kTasks = 20000;
+
+  PosixThread::ThreadPool pool("StrandPool");
+  pool.start(4);
+  {
+    PosixThread::Strand strand(&pool, 16);
+    int running = 0;
+    bool overlapped = false;
+    bool ordered = true;
+    std::vector<int> next(kProducers, 0); // 只在 strand 中访问, 不需要加锁
+    PosixThread::CountDownLatch done(kProducers * kTasks);
+
+    std::vector<std::unique_ptr<PosixThread::Thread>> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+      producers.emplace_back(new PosixThread::Thread([&, p]() {
+        for (int i = 0; i < kTasks; ++i)
+        {
+          strand.post([&, p, i]() {
+            if (PosixThread::detail::atomicFetchAdd(&running, 1) != 0)
+            {
+              overlapped = true;
+            }
+            ordered = ordered && next[p] == i && strand.runningInThisThread();
+            next[p] = i + 1;
+            PosixThread::detail::atomicFetchAdd(&running, -1);
+            done.CountDown();
+          });
+        }
+      }, "StrandProducer"));
+      producers.back()->start();
+    }
+    for (int p = 0; p < kProducers; ++p)
+    {
+      producers[p]->join();
+    }
+    done.Wait();
+    ASSERT_FALSE(overlapped);
+    ASSERT_TRUE(ordered);
+    ASSERT_FALSE(strand.runningInThisThread());
+  }
+  pool.stop();
+}
+
+TEST(StrandTest, BatchBudgetYields)
+{
+  // 执行器只是把 drain 存起来, 由测试手动执行, 可以精确地观察让出的次数
+  std::vector<PosixThread::Strand::Task> scheduled;
+  PosixThread::Strand strand([&](PosixThread::Strand::Task task) { scheduled.push_back(task); }, 8);
+
+  int executed = 0;
+  for (int i = 0; i < 20; ++i)
+  {
+    strand.post([&]() { ++executed; });
+  }
+  ASSERT_EQ(1u, scheduled.size());
+
+  size_t drains = 0;
+  while (drains < scheduled.size())
+  {
+    PosixThread::Strand::Task task = scheduled[drains++];
+    task();
+  }
+  ASSERT_EQ(20, executed);
+  ASSERT_EQ(3u, drains);
+
+  // dispatch 在 strand 内直接执行, 在 strand 外排队
+  std::vector<int> order;
+  strand.post([&]() {
+    strand.dispatch([&]() { order.push_back(1); });
+    order.push_back(2);
+  });
+  strand.dispatch([&]() { order.push_back(3); });
+  while (drains < scheduled.size())
+  {
+    PosixThread::Strand::Task task = scheduled[drains++];
+    task();
+  }
+  ASSERT_EQ(3u, order.size());
+  ASSERT_EQ(1, order[0]);
+  ASSERT_EQ(2, order[1]);
+  ASSERT_EQ(3, order[2]);
+
+  PosixThread::StrandStats stats = strand.stats();
+  ASSERT_EQ(22u, stats.executed);
+  ASSERT_EQ(2u, stats.yields);
+}
+
+// 线程池停止之后 post(): 在调用者线程执行, 析构函数不会一直等下去
+TEST(StrandTest, PostAfterPoolStopped)
+{
+  PosixThread::ThreadPool pool("StoppedPool");
+  pool.start(1);
+  pool.stop();
+  int executed = 0;
+  {
+    PosixThread::Strand strand(&pool);
+    for (int i = 0; i < 3; ++i)
+    {
+      strand.post([&executed]() { ++executed; });
+    }
+  }
+  ASSERT_EQ(3, executed);
+}
+
+TEST(StrandTest, ThrowingTaskKeepsStrandUsable)
+{
+  std::vector<PosixThread::Strand::Task> scheduled;
+  int executed = 0;
+  {
+    PosixThread::Strand strand([&](PosixThread::Strand::Task task) { scheduled.push_back(task); }, 8);
+    strand.post([&]() { ++executed; });
+    strand.post([&]() { throw std::runtime_error("task failed"); });
+    strand.post([&]() {
+      ASSERT_TRUE(strand.runningInThisThread());
+      ++executed;
+    });
+    ASSERT_EQ(1u, scheduled.size());
+
+    // 异常抛给执行器, 剩下的任务重新提交
+    ASSERT_THROW(scheduled[0](), std::runtime_error);
+    ASSERT_FALSE(strand.runningInThisThread());
+    ASSERT_EQ(1, executed);
+    ASSERT_EQ(2u, scheduled.size());
+
+    scheduled[1]();
+    ASSERT_EQ(2, executed);
+    PosixThread::StrandStats stats = strand.stats();
+    ASSERT_EQ(3u, stats.executed);
+
+    // 计数已经配平, 之后的 post 会重新调度
+    strand.post([&]() { ++executed; });
+    ASSERT_EQ(3u, scheduled.size());
+    scheduled[2]();
+  } // 析构函数不会一直等待
+  ASSERT_EQ(3, executed);
+}
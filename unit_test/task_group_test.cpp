@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include "test_util.h"
+#include <Atomic.h>
+#include <CountDownLatch.h>
+#include <TaskGroup.h>
+#include <thread_pool.h>
+#include <stdexcept>
+#include <unistd.h>
+
+TEST(TaskGroupTest, WaitForChildren)
+{
+  PosixThread::ThreadPool pool("GroupPool");
+  pool.start(2);
+
+  int64_t sum = 0;
+  PosixThread::TaskGroup group(&pool);
+  for (int i = 1; i <= 1000; ++i)
+  {
+    group.spawn([&sum, i]() { PosixThread::detail::atomicFetchAdd(&sum, static_cast<int64_t>(i)); });
+  }
+  group.wait();
+  ASSERT_EQ(500500, sum);
+  ASSERT_EQ(0u, group.skipped());
+
+  // wait() 之后可以继续使用
+  group.spawn([&sum]() { PosixThread::detail::atomicFetchAdd(&sum, static_cast<int64_t>(1)); });
+  group.wait();
+  ASSERT_EQ(500501, sum);
+  pool.stop();
+}
+
+// 线程池已经停止: run() 拒绝任务, spawn() 在调用者线程执行子任务, wait() 不会一直等下去
+TEST(TaskGroupTest, SpawnAfterPoolStopped)
+{
+  PosixThread::ThreadPool pool("GroupPool");
+  pool.start(2);
+  pool.stop();
+  ASSERT_FALSE(pool.run([]() {}));
+
+  int tid = 0;
+  PosixThread::TaskGroup group(&pool);
+  group.spawn([&tid]() { tid = PosixThread::CurrentThread::tid(); });
+  group.spawn([]() { throw std::runtime_error("child failed"); });
+  ASSERT_THROW(group.wait(), std::runtime_error);
+  ASSERT_EQ(PosixThread::CurrentThread::tid(), tid);
+}
+
+// 只有一个工作线程, 父任务在工作线程中 wait(): 不帮忙执行子任务就会死锁
+TEST(TaskGroupTest, NestedWaitHelps)
+{
+  PosixThread::ThreadPool pool("GroupPool");
+  pool.start(1);
+
+  int leaves = 0;
+  PosixThread::CountDownLatch done(1);
+  pool.run([&]() {
+    PosixThread::TaskGroup outer(&pool);
+    for (int i = 0; i < 4; ++i)
+    {
+      outer.spawn([&]() {
+        PosixThread::TaskGroup inner(&pool);
+        for (int j = 0; j < 8; ++j)
+        {
+          inner.spawn([&]() { ++leaves; });
+        }
+        inner.wait();
+      });
+    }
+    outer.wait();
+    done.CountDown();
+  });
+  done.Wait();
+  ASSERT_EQ(32, leaves);
+  pool.stop();
+}
+
+TEST(TaskGroupTest, FirstExceptionCancelsSiblings)
+{
+  PosixThread::ThreadPool pool("GroupPool");
+  pool.start(1);
+
+  // 先让唯一的工作线程忙起来, 子任务都在队列中排队
+  PosixThread::CountDownLatch blocked(1);
+  PosixThread::CountDownLatch release(1);
+  pool.run([&]() {
+    blocked.CountDown();
+    release.Wait();
+  });
+  blocked.Wait();
+
+  int started = 0;
+  int polled = 0;
+  PosixThread::TaskGroup group(&pool);
+  group.spawn([&]() {
+    PosixThread::detail::atomicFetchAdd(&started, 1);
+    throw std::runtime_error("shard 0 failed");
+  });
+  group.spawn([&]() {
+    PosixThread::detail::atomicFetchAdd(&started, 1);
+    throw std::logic_error("shard 1 failed");
+  });
+  for (int i = 0; i < 100; ++i)
+  {
+    group.spawn([&]() {
+      PosixThread::detail::atomicFetchAdd(&started, 1);
+      while (!group.token().isCancelled())
+      {
+        ++polled;
+      }
+    });
+  }
+  release.CountDown();
+
+  // 工作线程和 wait() 中帮忙的当前线程可能同时执行前两个子任务, 哪个异常先到不确定,
+  // 但是两者都会在取下一个子任务之前取消整个组, 后面的子任务一个也不会开始
+  bool caught = false;
+  try
+  {
+    group.wait();
+  }
+  catch (const std::exception &e)
+  {
+    caught = std::string(e.what()).find("failed") != std::string::npos;
+  }
+  ASSERT_TRUE(caught);
+  ASSERT_TRUE(group.isCancelled());
+  ASSERT_GE(started, 1);
+  ASSERT_LE(started, 2);
+  ASSERT_EQ(0, polled);
+  ASSERT_EQ(102u, static_cast<uint64_t>(started) + group.skipped());
+  pool.stop();
+}
+
+// 外部 token 取消正在执行的子任务, 子任务轮询 isCancelled() 提前返回
+TEST(TaskGroupTest, SharedTokenStopsRunningChildren)
+{
+  PosixThread::ThreadPool pool("GroupPool");
+  pool.start(2);
+
+  PosixThread::CancellationToken request;
+  int64_t start = nowNanos();
+  {
+    PosixThread::TaskGroup group(&pool, request);
+    for (int i = 0; i < 4; ++i)
+    {
+      group.spawn([&]() {
+        while (!request.isCancelled())
+        {
+          ::usleep(100);
+        }
+      });
+    }
+    ::usleep(10 * 1000);
+    request.cancel();
+    group.wait();
+  }
+  ASSERT_LT(nowNanos() - start, 1000LL * 1000 * 1000);
+  pool.stop();
+}
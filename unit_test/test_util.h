@@ -0,0 +1,15 @@
+#ifndef __TEST_UTIL_H__
+#define __TEST_UTIL_H__
+
+#include <stdint.h>
+#include <time.h>
+
+// CLOCK_MONOTONIC 的纳秒数, 测试中测量耗时用
+inline int64_t nowNanos()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+#endif // !__TEST_UTIL_H__
@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+#include <thread_pool.h>
+#include <algorithm>
+
+TEST(ThreadPoolTest, RunTasks)
+{
+  PosixThread::ThreadPool pool("TestPool");
+  pool.setMaxQueueSize(16);
+  pool.start(4);
+
+  const int kTasks = 1000;
+  PosixThread::AtomicInt32 done;
+  PosixThread::CountDownLatch latch(kTasks);
+  for (int i = 0; i < kTasks; ++i)
+  {
+    pool.run([&done, &latch]() {
+      done.increment();
+      latch.CountDown();
+    });
+  }
+  latch.Wait();
+  pool.stop();
+
+  ASSERT_EQ(done.get(), kTasks);
+  ASSERT_EQ(pool.queueSize(), 0u);
+}
+
+TEST(ThreadPoolTest, RunInCallerWithoutThreads)
+{
+  PosixThread::ThreadPool pool;
+  pool.start(0);
+
+  int tid = 0;
+  pool.run([&tid]() { tid = PosixThread::CurrentThread::tid(); });
+  ASSERT_EQ(tid, PosixThread::CurrentThread::tid());
+}
+
+TEST(ThreadPoolTest, Stats)
+{
+  PosixThread::ThreadPool pool("StatsPool");
+  pool.start(2);
+
+  const int kTasks = 200;
+  PosixThread::CountDownLatch latch(kTasks);
+  for (int i = 0; i < kTasks; ++i)
+  {
+    pool.run([&latch]() {
+      PosixThread::CurrentThread::sleepUsec(10);
+      latch.CountDown();
+    });
+  }
+  latch.Wait();
+
+  // 不停止线程池直接取快照: CountDown() 之后的任务可能还没记录自己的统计, 只检查不依赖时序的字段
+  PosixThread::ThreadPoolStats stats = pool.stats();
+  ASSERT_EQ(stats.workers.size(), 2u);
+  ASSERT_GE(stats.maxQueueDepth, 1u);
+
+  // 停止之后所有任务都已经记录
+  pool.stop();
+  stats = pool.stats();
+  if (stats.enabled)
+  {
+    uint64_t tasks = 0;
+    for (size_t i = 0; i < stats.workers.size(); ++i)
+    {
+      tasks += stats.workers[i].tasks;
+      ASSERT_GE(stats.workers[i].idleNs, 0);
+    }
+    ASSERT_EQ(static_cast<uint64_t>(kTasks), tasks);
+    ASSERT_EQ(static_cast<uint64_t>(kTasks), stats.runTime.count());
+    ASSERT_GE(stats.runTime.percentile(50), 10 * 1000);
+  }
+}
+
+TEST(LatencyHistogramTest, Percentile)
+{
+  PosixThread::LatencyHistogram hist;
+  for (int64_t i = 1; i <= 10000; ++i)
+  {
+    hist.record(i);
+  }
+  ASSERT_EQ(hist.count(), 10000u);
+  ASSERT_EQ(hist.min(), 1);
+  ASSERT_EQ(hist.max(), 10000);
+
+  // 对数-线性分桶的相对误差不超过 1/16
+  int64_t p50 = hist.percentile(50);
+  int64_t p99 = hist.percentile(99);
+  ASSERT_NEAR(p50, 5000, 5000 / 16);
+  ASSERT_NEAR(p99, 9900, 9900 / 16);
+  ASSERT_EQ(hist.percentile(100), 10000);
+
+  PosixThread::LatencyHistogram merged;
+  merged.merge(hist);
+  merged.merge(hist);
+  ASSERT_EQ(merged.count(), 20000u);
+  ASSERT_EQ(merged.percentile(50), p50);
+}
+
+TEST(ElasticThreadPoolTest, GrowAndShrink)
+{
+  PosixThread::ThreadPool pool("ElasticPool");
+  pool.setElastic(4, 1000, 0.05); // 排队超过 1ms 扩容, 空闲 50ms 缩容
+  pool.start(1);
+  ASSERT_EQ(pool.numThreads(), 1);
+
+  const int kTasks = 40;
+  PosixThread::CountDownLatch latch(kTasks);
+  int maxThreads = 0;
+  for (int i = 0; i < kTasks; ++i)
+  {
+    pool.run([&latch]() {
+      PosixThread::CurrentThread::sleepUsec(2000);
+      latch.CountDown();
+    });
+    maxThreads = std::max(maxThreads, pool.numThreads());
+    PosixThread::CurrentThread::sleepUsec(500);
+  }
+  latch.Wait();
+  ASSERT_GT(maxThreads, 1);
+  ASSERT_LE(maxThreads, 4);
+
+  // 非核心线程空闲超时后退出, 只剩核心线程
+  for (int i = 0; i < 100 && pool.numThreads() > 1; ++i)
+  {
+    PosixThread::CurrentThread::sleepUsec(10 * 1000);
+  }
+  ASSERT_EQ(pool.numThreads(), 1);
+
+  // 退出线程的槽位被复用, 槽位数不超过最大线程数
+  PosixThread::CountDownLatch again(kTasks);
+  for (int i = 0; i < kTasks; ++i)
+  {
+    pool.run([&again]() {
+      PosixThread::CurrentThread::sleepUsec(2000);
+      again.CountDown();
+    });
+    PosixThread::CurrentThread::sleepUsec(500);
+  }
+  again.Wait();
+  ASSERT_LE(pool.stats().workers.size(), 4u);
+  pool.stop();
+}
+
+TEST(PriorityThreadPoolTest, DeadlineOrderAndExpiry)
+{
+  PosixThread::ThreadPool pool("DeadlinePool");
+  pool.start(1);
+
+  // 先用一个任务占住唯一的工作线程, 后面的任务都在队列里排队
+  PosixThread::CountDownLatch started(1);
+  PosixThread::CountDownLatch blocker(1);
+  pool.run([&started, &blocker]() {
+    started.CountDown();
+    blocker.Wait();
+  });
+  started.Wait();
+
+  std::vector<int> order;
+  PosixThread::MutexLock mutex;
+  auto record = [&order, &mutex](int id) {
+    PosixThread::MutexLockGuard<PosixThread::MutexLock> lock(mutex);
+    order.push_back(id);
+  };
+  pool.run(std::bind(record, 0));                        // 没有截止时间, 排在带截止时间的任务之后
+  pool.run(std::bind(record, 30), 0, 30 * 1000 * 1000);
+  pool.run(std::bind(record, 10), 0, 10 * 1000 * 1000);
+  pool.run(std::bind(record, 20), 0, 20 * 1000 * 1000);
+  pool.run(std::bind(record, -1), 0, 1000);              // 1ms 后过期
+  PosixThread::CurrentThread::sleepUsec(5 * 1000);
+  blocker.CountDown();
+
+  PosixThread::CountDownLatch done(1);
+  pool.run([&done]() { done.CountDown(); });
+  done.Wait();
+  pool.stop();
+
+  ASSERT_EQ(order.size(), 4u);
+  ASSERT_EQ(order[0], 10);
+  ASSERT_EQ(order[1], 20);
+  ASSERT_EQ(order[2], 30);
+  ASSERT_EQ(order[3], 0);
+  ASSERT_EQ(pool.stats().expired, 1u);
+}
+
+// 同一通道中源源不断的截止时间任务不能让没有截止时间的任务饿死:
+// 每个截止时间任务执行时再提交一个新的, 堆永远不空, FIFO 任务最多等 kMaxDeadlineStreak 次
+TEST(PriorityThreadPoolTest, DeadlineTrafficDoesNotStarveFifo)
+{
+  PosixThread::ThreadPool pool("StarvePool");
+  pool.start(1);
+
+  PosixThread::CountDownLatch started(1);
+  PosixThread::CountDownLatch blocker(1);
+  pool.run([&started, &blocker]() {
+    started.CountDown();
+    blocker.Wait();
+  });
+  started.Wait();
+
+  const int kFifo = 3;
+  const int kMaxDeadlineRuns = 200;
+  std::vector<int> order; // 只有唯一的工作线程写
+  PosixThread::CountDownLatch fifoDone(kFifo);
+  std::function<void()> deadlineTask = [&]() {
+    order.push_back(1);
+    if (static_cast<int>(order.size()) < kMaxDeadlineRuns)
+    {
+      pool.run(deadlineTask, 0, 1000 * 1000 * 1000);
+    }
+  };
+  for (int i = 0; i < 4; ++i)
+  {
+    pool.run(deadlineTask, 0, 1000 * 1000 * 1000);
+  }
+  for (int i = 0; i < kFifo; ++i)
+  {
+    pool.run([&order, &fifoDone]() {
+      order.push_back(0);
+      fifoDone.CountDown();
+    });
+  }
+  blocker.CountDown();
+  fifoDone.Wait();
+  pool.stop();
+
+  // 每个 FIFO 任务之前最多有 8 个截止时间任务
+  int streak = 0;
+  int fifoSeen = 0;
+  for (size_t i = 0; i < order.size() && fifoSeen < kFifo; ++i)
+  {
+    if (order[i] == 0)
+    {
+      ++fifoSeen;
+      streak = 0;
+    }
+    else
+    {
+      ASSERT_LE(++streak, 8);
+    }
+  }
+  ASSERT_EQ(kFifo, fifoSeen);
+}
+
+TEST(PriorityThreadPoolTest, WeightedFairDequeue)
+{
+  PosixThread::ThreadPool pool("WeightedPool");
+  pool.setPriorityWeights({3, 1});
+  pool.start(1);
+
+  PosixThread::CountDownLatch started(1);
+  PosixThread::CountDownLatch blocker(1);
+  pool.run([&started, &blocker]() {
+    started.CountDown();
+    blocker.Wait();
+  });
+  started.Wait();
+
+  std::vector<int> order;
+  PosixThread::CountDownLatch done(16);
+  for (int i = 0; i < 8; ++i)
+  {
+    pool.run([&order, &done]() {
+      order.push_back(1);
+      done.CountDown();
+    }, 1);
+    pool.run([&order, &done]() {
+      order.push_back(0);
+      done.CountDown();
+    }, 0);
+  }
+  PosixThread::ThreadPoolStats stats = pool.stats();
+  ASSERT_EQ(stats.laneDepth.size(), 2u);
+  ASSERT_EQ(stats.laneDepth[0], 8u);
+  ASSERT_EQ(stats.laneDepth[1], 8u);
+  blocker.CountDown();
+  done.Wait();
+  pool.stop();
+
+  // 前 8 个出队的任务中, 通道 0 与通道 1 按 3:1 分配
+  ASSERT_EQ(order.size(), 16u);
+  ASSERT_EQ(std::count(order.begin(), order.begin() + 8, 0), 6);
+  ASSERT_EQ(std::count(order.begin(), order.begin() + 8, 1), 2);
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <Timestamp.h>
+#include <posix_thread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST(TimestampTest, Conversions)
+{
+  PosixThread::Timestamp t = PosixThread::Timestamp::fromMillis(1500);
+  ASSERT_EQ(1500000000, t.nanos());
+  ASSERT_EQ(1500000, t.micros());
+  ASSERT_DOUBLE_EQ(1.5, t.seconds());
+
+  struct timespec ts = t.toTimespec();
+  ASSERT_EQ(1, ts.tv_sec);
+  ASSERT_EQ(500000000, ts.tv_nsec);
+  ASSERT_TRUE(PosixThread::Timestamp::fromTimespec(ts) == t);
+
+  PosixThread::Timestamp later = PosixThread::addTime(t, 0.25);
+  ASSERT_TRUE(t < later);
+  ASSERT_EQ(250000000, PosixThread::nanosBetween(later, t));
+  ASSERT_DOUBLE_EQ(0.25, PosixThread::timeDifference(later, t));
+  ASSERT_FALSE(PosixThread::Timestamp::invalid().valid());
+  ASSERT_TRUE(PosixThread::Timestamp::now().valid());
+}
+
+// FastClock 与 CLOCK_MONOTONIC 在同一时间轴上, 经过重新校准之后仍然跟得上
+TEST(TimestampTest, TracksMonotonicClock)
+{
+  printf("FastClock mode: %s, %.3f GHz\n",
+         PosixThread::FastClock::mode() == PosixThread::FastClock::kTsc ? "tsc" : "monotonic",
+         PosixThread::FastClock::ticksPerSecond() / 1e9);
+
+  for (int round = 0; round < 3; ++round)
+  {
+    int64_t before = PosixThread::FastClock::monotonicNanos();
+    int64_t fast = PosixThread::FastClock::nowNanos();
+    int64_t after = PosixThread::FastClock::monotonicNanos();
+    // 2ms 的余量: 落后不超过 1ms 时重新校准不跳变, 而是在之后的 1 秒内慢慢追上, 这期间最多差 1ms,
+    // 再加上校准时读数对的误差
+    ASSERT_GE(fast, before - 2 * 1000 * 1000);
+    ASSERT_LE(fast, after + 2 * 1000 * 1000);
+    ::usleep(200 * 1000);
+    PosixThread::FastClock::recalibrate();
+  }
+
+  uint64_t start = PosixThread::FastClock::ticks();
+  ::usleep(50 * 1000);
+  int64_t elapsed = PosixThread::FastClock::ticksToNanos(PosixThread::FastClock::ticksOrdered() - start);
+  ASSERT_GE(elapsed, 49 * 1000 * 1000);
+  ASSERT_LT(elapsed, 500 * 1000 * 1000);
+}
+
+// 运行中 TSC 偏差过大退化为 CLOCK_MONOTONIC: 此前的换算值比 CLOCK_MONOTONIC 快, 退化之后也不能往回跳.
+// 退化会改变全局状态, 在子进程中进行
+TEST(TimestampTest, FallbackStaysMonotonic)
+{
+  if (PosixThread::FastClock::mode() != PosixThread::FastClock::kTsc)
+  {
+    return;
+  }
+  pid_t pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    // 让换算结果比 CLOCK_MONOTONIC 快 100ms, 连续校准几次之后判定 TSC 不可靠
+    PosixThread::detail::FastClockState &state = PosixThread::detail::g_fastClock;
+    state.baseNanos += 100 * 1000 * 1000;
+    int64_t last = PosixThread::FastClock::nowNanos();
+    for (int i = 0; i < 3; ++i)
+    {
+      PosixThread::FastClock::recalibrate();
+    }
+    if (PosixThread::FastClock::mode() != PosixThread::FastClock::kMonotonic)
+    {
+      ::_exit(1);
+    }
+    for (int i = 0; i < 100000; ++i)
+    {
+      int64_t now = PosixThread::FastClock::nowNanos();
+      if (now < last)
+      {
+        ::_exit(2);
+      }
+      last = now;
+    }
+    ::_exit(0);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+// slew 之后的倍率只用于一个校准周期: 之后很久没有人读时钟, 换算结果也不会越走越偏.
+// 同样会改变全局状态, 在子进程中进行
+TEST(TimestampTest, SlewDoesNotOutliveRecalibrationWindow)
+{
+  if (PosixThread::FastClock::mode() != PosixThread::FastClock::kTsc)
+  {
+    return;
+  }
+  pid_t pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    // 让换算结果落后 0.9ms (不到直接跳变的 1ms), 重新校准后倍率加快约 0.09%
+    PosixThread::FastClock::recalibrate();
+    PosixThread::detail::g_fastClock.baseNanos -= 900 * 1000;
+    PosixThread::FastClock::recalibrate();
+    if (PosixThread::detail::g_fastClock.slewMult <= PosixThread::detail::g_fastClock.mult)
+    {
+      ::_exit(1);
+    }
+    // 空闲 2 秒: 如果一直按加快的倍率换算, 会比 CLOCK_MONOTONIC 快约 0.9ms
+    ::usleep(2 * 1000 * 1000);
+    int64_t fast = PosixThread::FastClock::nowNanos();
+    int64_t error = fast - PosixThread::FastClock::monotonicNanos();
+    ::_exit(error < 400 * 1000 && error > -400 * 1000 ? 0 : 2);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(TimestampTest, MonotonicAcrossThreads)
+{
+  const int kThreads = 4;
+  const int kReads = 200000;
+  bool monotonic[kThreads];
+  std::vector<std::unique_ptr<PosixThread::Thread>> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    monotonic[t] = true;
+    threads.emplace_back(new PosixThread::Thread([&monotonic, t]() {
+      PosixThread::Timestamp last = PosixThread::Timestamp::now();
+      for (int i = 0; i < kReads; ++i)
+      {
+        PosixThread::Timestamp now = PosixThread::Timestamp::now();
+        monotonic[t] = monotonic[t] && now >= last;
+        last = now;
+      }
+    }, "ClockReader"));
+    threads.back()->start();
+  }
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads[t]->join();
+    ASSERT_TRUE(monotonic[t]);
+  }
+}